@@ -0,0 +1,220 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/3
+
+/**
+ * @file autotuner.cpp
+ *
+ * @brief Implements the AutoTuner class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by autotuner.h otherwise.
+ */
+
+#include "autotuner.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace autotuner_detail {
+
+/**
+ * @brief 64-bit FNV-1a hash, stable across processes unlike std::hash.
+ */
+struct Fnv {
+    uint64_t value = 14695981039346656037ull;
+
+    void add(const void* data, size_t bytes) {
+        const unsigned char* begin = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < bytes; ++i) {
+            value = (value ^ begin[i]) * 1099511628211ull;
+        }
+    }
+
+    void add(uint64_t number) {
+        unsigned char bytes[8];
+        for (size_t i = 0; i < 8; ++i) {
+            bytes[i] = static_cast<unsigned char>(number >> (8 * i));
+        }
+        add(bytes, sizeof(bytes));
+    }
+
+    void add(const std::string& text) {
+        add(text.size());
+        add(text.data(), text.size());
+    }
+};
+
+} // namespace autotuner_detail
+
+DAG_INLINE AutoTuner::AutoTuner(const std::string& path) : m_path(path) {
+    if (m_path.empty()) {
+        return;
+    }
+    std::ifstream in(m_path);
+    if (in) {
+        load(in);
+    }
+}
+
+DAG_INLINE TunedConfig AutoTuner::tune(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches,
+                                       bool retune) {
+    m_calibrationRuns = 0;
+    uint64_t key = hash(graph, inputBatches);
+    auto known = m_configs.find(key);
+    if (known != m_configs.end() && !retune) {
+        return known->second;
+    }
+
+    std::vector<std::unordered_map<std::string, MiniBatch>> calibration(
+        inputBatches.begin(), inputBatches.begin() + std::min(inputBatches.size(), m_calibrationBatches));
+    size_t maxThreads = m_maxThreads != 0 ? m_maxThreads : defaultWorkerCount();
+    std::vector<size_t> threadCounts;
+    for (size_t numThreads = 1; numThreads < maxThreads; numThreads *= 2) {
+        threadCounts.push_back(numThreads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    TunedConfig best;
+    best.seconds = std::numeric_limits<double>::infinity();
+    auto tryCandidate = [&](const TunedConfig& config) {
+        TunedConfig candidate = config;
+        candidate.seconds = time(graph, calibration, candidate);
+        if (candidate.seconds < best.seconds) {
+            best = candidate;
+        }
+    };
+    for (size_t numThreads : threadCounts) {
+        TunedConfig candidate = best;
+        candidate.numThreads = numThreads;
+        tryCandidate(candidate);
+    }
+    // inline runs neither prefetch nor coarsen
+    if (best.numThreads > 1) {
+        for (size_t prefetchLimit : {size_t(0), size_t(64 * 1024), size_t(1024 * 1024)}) {
+            TunedConfig candidate = best;
+            candidate.prefetchLimit = prefetchLimit;
+            tryCandidate(candidate);
+        }
+        // grains of a few average tasks, the time of a task being that of a worker's share of the run
+        size_t numTasks = std::max<size_t>(1, graph.size() * calibration.size());
+        double taskSeconds = best.seconds * static_cast<double>(best.numThreads) / static_cast<double>(numTasks);
+        for (double tasksPerGrain : {4.0, 16.0}) {
+            TunedConfig candidate = best;
+            candidate.grainSeconds = taskSeconds * tasksPerGrain;
+            tryCandidate(candidate);
+        }
+    }
+
+    m_configs[key] = best;
+    if (!m_path.empty()) {
+        std::ofstream out(m_path);
+        save(out);
+        if (!out) {
+            throw std::runtime_error("Cannot write the autotuning file " + m_path + ".");
+        }
+    }
+    return best;
+}
+
+DAG_INLINE uint64_t AutoTuner::hash(const Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches) {
+    autotuner_detail::Fnv fnv;
+    fnv.add(graph.size());
+    fnv.add(graph.isBufferReuseEnabled());
+    for (size_t nodeId = 0; nodeId < graph.size(); ++nodeId) {
+        const GraphNode& node = graph.getNode(nodeId);
+        fnv.add(node.getComputeType() == ComputeType::CPU);
+        for (const auto& input : node.getInputs()) {
+            fnv.add(input.first);
+            fnv.add(node.getInputType(input.first));
+        }
+        fnv.add(std::string("->"));
+        for (const auto& output : node.getOutputs()) {
+            fnv.add(output.first);
+            fnv.add(node.getOutputType(output.first));
+        }
+    }
+    for (size_t from = 0; from < graph.size(); ++from) {
+        for (size_t to = 0; to < graph.size(); ++to) {
+            if (!graph.edgeExists(from, to)) {
+                continue;
+            }
+            fnv.add(from);
+            fnv.add(to);
+            for (const auto& port : graph.getEdgePorts(from, to)) {
+                fnv.add(port.outPort);
+                fnv.add(port.inPort);
+            }
+        }
+    }
+    size_t elements = 0;
+    for (const auto& batchMap : inputBatches) {
+        for (const auto& inputField : batchMap) {
+            elements += inputField.second.size();
+        }
+    }
+    fnv.add(inputBatches.size());
+    fnv.add(elements == 0 ? 0 : static_cast<size_t>(std::log2(static_cast<double>(elements))));
+    return fnv.value;
+}
+
+DAG_INLINE void AutoTuner::save(std::ostream& out) const {
+    out << "dag-autotune 2\n";
+    out << "configs " << m_configs.size() << "\n";
+    for (const auto& config : m_configs) {
+        out << "config " << std::hex << config.first << std::dec << " " << config.second.numThreads << " "
+            << config.second.prefetchLimit << " " << config.second.grainSeconds << " " << config.second.seconds << "\n";
+    }
+}
+
+DAG_INLINE void AutoTuner::load(std::istream& in) {
+    std::string token;
+    size_t version = 0;
+    size_t count = 0;
+    in >> token >> version;
+    if (token != "dag-autotune" || (version != 1 && version != 2)) {
+        throw std::runtime_error("Malformed autotuning file.");
+    }
+    in >> token >> count;
+    if (token != "configs") {
+        throw std::runtime_error("Malformed autotuning file: expected configs.");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t key = 0;
+        TunedConfig config;
+        in >> token >> std::hex >> key >> std::dec >> config.numThreads >> config.prefetchLimit;
+        if (version >= 2) {
+            in >> config.grainSeconds;
+        }
+        in >> config.seconds;
+        if (token != "config" || !in || config.numThreads == 0) {
+            throw std::runtime_error("Malformed autotuning file: expected config.");
+        }
+        m_configs[key] = config;
+    }
+}
+
+DAG_INLINE double AutoTuner::time(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& calibration,
+                                  const TunedConfig& config) {
+    std::vector<double> seconds;
+    for (size_t i = 0; i < m_repetitions; ++i) {
+        Executor executor(graph, calibration);
+        config.apply(executor);
+        if (config.grainSeconds > 0.0) {
+            // clusters are formed from the costs measured by a previous run
+            executor.run();
+            executor.reset();
+            m_calibrationRuns++;
+        }
+        auto start = std::chrono::steady_clock::now();
+        executor.run();
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        m_calibrationRuns++;
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return seconds[seconds.size() / 2];
+}
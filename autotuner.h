@@ -0,0 +1,161 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/3
+
+/**
+ * @file autotuner.h
+ *
+ * @brief Chooses the executor parameters by timing short calibration runs of the actual workload.
+ *
+ * The AutoTuner times the graph on a prefix of its input batches under several worker counts, prefetch
+ * limits and coarsening grains, keeps the fastest configuration, and persists it to a plain text file keyed by a hash of the
+ * graph structure and of the shape of the inputs, so later startups reuse it without calibrating again.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dag_config.h"
+#include "executor.h"
+
+/**
+ * @brief Executor parameters chosen by the AutoTuner.
+ */
+struct TunedConfig {
+    size_t numThreads = 1; ///< Number of worker threads, 1 runs inline.
+    size_t prefetchLimit = 256 * 1024; ///< Bytes of the next task's inputs prefetched.
+    double grainSeconds = 0.0; ///< Coarsening grain, see Executor::setCoarsening(); 0 for none.
+    double seconds = 0.0; ///< Median calibration run time of the configuration.
+
+    /**
+     * @brief Applies the configuration to an executor.
+     *
+     * @param executor The executor.
+     */
+    void apply(Executor& executor) const {
+        executor.setNumThreads(numThreads);
+        executor.setExecutionMode(numThreads == 1 ? ExecutionMode::Inline : ExecutionMode::Parallel);
+        executor.setPrefetchLimit(prefetchLimit);
+        executor.setCoarsening(grainSeconds);
+    }
+};
+
+class AutoTuner {
+public:
+    /**
+     * @brief Constructs an AutoTuner persisting its configurations to a file.
+     *
+     * The configurations already in the file are loaded; a missing file is treated as empty.
+     *
+     * @param path The configuration file, or an empty string to keep the configurations in memory only.
+     * @throws std::runtime_error If the file exists but is malformed.
+     */
+    explicit AutoTuner(const std::string& path = std::string());
+
+    /**
+     * @brief Sets how many input batches the calibration runs process.
+     *
+     * @param numBatches Number of leading input batches, 8 by default.
+     */
+    void setCalibrationBatches(size_t numBatches) {
+        m_calibrationBatches = std::max<size_t>(1, numBatches);
+    }
+
+    /**
+     * @brief Sets how many times each candidate configuration is timed.
+     *
+     * @param repetitions Number of runs per candidate, the median is kept; 3 by default.
+     */
+    void setRepetitions(size_t repetitions) {
+        m_repetitions = std::max<size_t>(1, repetitions);
+    }
+
+    /**
+     * @brief Sets the largest worker count tried.
+     *
+     * @param maxThreads The largest worker count, 0 for defaultWorkerCount().
+     */
+    void setMaxThreads(size_t maxThreads) {
+        m_maxThreads = maxThreads;
+    }
+
+    /**
+     * @brief Gets the configuration of a workload, calibrating it if it hasn't been tuned before.
+     *
+     * The calibration runs execute the graph, overwriting its MiniBatches; an Executor constructed
+     * afterwards initializes them again. Worker counts are searched first, doubling up to the maximum,
+     * then the prefetch limit at the best worker count, then the coarsening grain, in multiples of the
+     * average task time. A coarsened candidate is timed on its second run, once the first one has
+     * measured the cost of every node. A new configuration is saved to the file.
+     *
+     * @param graph The graph.
+     * @param inputBatches The input batches the graph will process.
+     * @param retune True to calibrate again even if a configuration is known.
+     * @return The configuration.
+     */
+    TunedConfig tune(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches,
+                     bool retune = false);
+
+    /**
+     * @brief Number of executor runs performed by the last call to tune(), 0 if the configuration was known.
+     */
+    size_t calibrationRuns() const {
+        return m_calibrationRuns;
+    }
+
+    /**
+     * @brief Hashes the structure of a graph and the shape of its inputs.
+     *
+     * Covers the ports and declared types of every node, the edges with their port connections and the
+     * buffer reuse setting, together with the number of input batches and the total number of input
+     * elements rounded to a power of two. The hash is stable across processes and platforms.
+     *
+     * @param graph The graph.
+     * @param inputBatches The input batches.
+     * @return The hash.
+     */
+    static uint64_t hash(const Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches);
+
+    /**
+     * @brief Writes the known configurations in text format.
+     *
+     * @param out The stream to write to.
+     */
+    void save(std::ostream& out) const;
+
+    /**
+     * @brief Reads configurations written by save(), replacing the known ones with the same keys.
+     *
+     * Files written before the coarsening grain was tuned are read with a grain of 0.
+     *
+     * @param in The stream to read from.
+     * @throws std::runtime_error If the stream is malformed.
+     */
+    void load(std::istream& in);
+
+private:
+    std::string m_path; // Configuration file, empty for none
+    std::map<uint64_t, TunedConfig> m_configs; // Known configurations by workload hash
+    size_t m_calibrationBatches = 8; // Input batches processed by a calibration run
+    size_t m_repetitions = 3; // Runs per candidate configuration
+    size_t m_maxThreads = 0; // Largest worker count tried, 0 for defaultWorkerCount()
+    size_t m_calibrationRuns = 0; // Executor runs performed by the last tune()
+
+    /**
+     * @brief Median run time of a configuration on the calibration batches.
+     */
+    double time(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& calibration,
+                const TunedConfig& config);
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "autotuner.cpp"
+#endif
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dag.h"
+
+// Chain of element-wise nodes: node i reads "stage<i>" and writes "stage<i+1>".
+static Graph buildChain(size_t numNodes, bool bufferReuse) {
+    Graph graph;
+    graph.setBufferReuse(bufferReuse);
+    for (size_t i = 0; i < numNodes; ++i) {
+        std::string in = "stage" + std::to_string(i);
+        std::string out = "stage" + std::to_string(i + 1);
+        GraphNode node(ComputeType::CPU, [in, out](auto& inputs, auto& outputs) {
+            outputs[out] = std::get<double>(inputs[in]) * 1.0001 + 1;
+        });
+        node.addInput(in, DataContainer());
+        node.addOutput(out, DataContainer());
+        node.setInPlace(in, out);
+        graph.addNode(node);
+        if (i > 0) {
+            graph.addEdge(i - 1, i);
+        }
+    }
+    return graph;
+}
+
+// Same chain as buildChain, given to a GraphBuilder in bulk.
+static Graph buildChainInBulk(size_t numNodes) {
+    GraphBuilder builder;
+    builder.reserve(numNodes, numNodes);
+    std::vector<std::pair<size_t, size_t>> edges;
+    for (size_t i = 0; i < numNodes; ++i) {
+        std::string in = "stage" + std::to_string(i);
+        std::string out = "stage" + std::to_string(i + 1);
+        GraphNode node(ComputeType::CPU, [in, out](auto& inputs, auto& outputs) {
+            outputs[out] = std::get<double>(inputs[in]) * 1.0001 + 1;
+        });
+        node.addInput(in, DataContainer());
+        node.addOutput(out, DataContainer());
+        node.setInPlace(in, out);
+        builder.addNode(std::move(node));
+        if (i > 0) {
+            edges.push_back({i - 1, i});
+        }
+    }
+    builder.addEdges(edges);
+    return builder.build();
+}
+
+// Same chain as buildChain, built from expression nodes evaluated column at a time.
+static Graph buildExpressionChain(size_t numNodes) {
+    Graph graph;
+    for (size_t i = 0; i < numNodes; ++i) {
+        std::string in = "stage" + std::to_string(i);
+        graph.addNode(makeExpressionNode("stage" + std::to_string(i + 1), in + " * 1.0001 + 1"));
+        if (i > 0) {
+            graph.addEdge(i - 1, i);
+        }
+    }
+    return graph;
+}
+
+// One root fanning out to numBranches independent element-wise nodes.
+static Graph buildFanOut(size_t numBranches) {
+    Graph graph;
+    GraphNode root(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        outputs["stage1"] = std::get<double>(inputs["stage0"]) + 1;
+    });
+    root.addInput("stage0", DataContainer());
+    root.addOutput("stage1", DataContainer());
+    size_t rootId = graph.addNode(root);
+    for (size_t i = 0; i < numBranches; ++i) {
+        std::string out = "branch" + std::to_string(i);
+        GraphNode node(ComputeType::CPU, [out](auto& inputs, auto& outputs) {
+            outputs[out] = std::get<double>(inputs["stage1"]) * 2;
+        });
+        node.addInput("stage1", DataContainer());
+        node.addOutput(out, DataContainer());
+        graph.addEdge(rootId, graph.addNode(node));
+    }
+    return graph;
+}
+
+// numNodes independent roots streaming over the same input field, one cheap operation per element.
+static Graph buildStream(size_t numNodes) {
+    Graph graph;
+    for (size_t i = 0; i < numNodes; ++i) {
+        std::string out = "stream" + std::to_string(i);
+        GraphNode node(ComputeType::CPU, [out](auto& inputs, auto& outputs) {
+            outputs[out] = std::get<double>(inputs["stage0"]);
+        });
+        node.addInput("stage0", DataContainer());
+        node.addOutput(out, DataContainer());
+        graph.addNode(node);
+    }
+    return graph;
+}
+
+static std::vector<std::unordered_map<std::string, MiniBatch>> makeInputs(size_t numBatches, size_t batchSize) {
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputBatches(numBatches);
+    for (size_t batchId = 0; batchId < numBatches; ++batchId) {
+        MiniBatch batch;
+        for (size_t i = 0; i < batchSize; ++i) {
+            batch.addData(static_cast<double>(batchId * batchSize + i));
+        }
+        inputBatches[batchId]["stage0"] = batch;
+    }
+    return inputBatches;
+}
+
+// Runs a benchmark case several times on a fresh graph and reports the median run time.
+static void benchmark(const std::string& name, size_t repetitions, size_t elements,
+                      const std::function<double()>& runOnce) {
+    std::vector<double> seconds;
+    for (size_t i = 0; i < repetitions; ++i) {
+        seconds.push_back(runOnce());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    double median = seconds[seconds.size() / 2];
+    std::cerr << name << ": " << median * 1e3 << " ms, " << elements / median << " elem/s" << std::endl;
+}
+
+// numThreads threads each incrementing their own counter, adjacent in memory unless Counter is padded.
+template <typename Counter>
+static double timeCounters(size_t numThreads, size_t increments) {
+    std::vector<Counter> counters(numThreads);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&counters, i, increments] {
+            for (size_t n = 0; n < increments; ++n) {
+                counters[i].value.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct SharedCounter {
+    std::atomic<size_t> value{0};
+};
+
+struct alignas(DAG_CACHE_LINE_SIZE) PaddedCounter {
+    std::atomic<size_t> value{0};
+};
+
+static double timeRun(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputs,
+                      ExecutionMode mode, size_t prefetchLimit = 256 * 1024, size_t numThreads = 0,
+                      double grainSeconds = 0.0) {
+    Executor executor(graph, inputs);
+    executor.setExecutionMode(mode);
+    executor.setCoarsening(grainSeconds);
+    executor.setNumThreads(numThreads);
+    executor.setPrefetchLimit(prefetchLimit);
+    auto start = std::chrono::steady_clock::now();
+    executor.run();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t repetitions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5;
+    repetitions = std::max<size_t>(1, repetitions);
+
+    const size_t numBatches = 64;
+    const size_t batchSize = 4096;
+    const auto inputs = makeInputs(numBatches, batchSize);
+    const size_t chainNodes = 8;
+    const size_t chainElements = chainNodes * numBatches * batchSize;
+
+    benchmark("chain/parallel", repetitions, chainElements, [&] {
+        Graph graph = buildChain(chainNodes, false);
+        return timeRun(graph, inputs, ExecutionMode::Parallel);
+    });
+    benchmark("chain/parallel/buffer-reuse", repetitions, chainElements, [&] {
+        Graph graph = buildChain(chainNodes, true);
+        return timeRun(graph, inputs, ExecutionMode::Parallel);
+    });
+    benchmark("chain/inline", repetitions, chainElements, [&] {
+        Graph graph = buildChain(chainNodes, false);
+        return timeRun(graph, inputs, ExecutionMode::Inline);
+    });
+
+    benchmark("chain/expression", repetitions, chainElements, [&] {
+        Graph graph = buildExpressionChain(chainNodes);
+        return timeRun(graph, inputs, ExecutionMode::Parallel);
+    });
+    benchmark("chain/expression/fused", repetitions, chainElements, [&] {
+        Graph graph = fuseExpressions(buildExpressionChain(chainNodes));
+        return timeRun(graph, inputs, ExecutionMode::Parallel);
+    });
+
+    const size_t branches = 32;
+    benchmark("fan-out/parallel", repetitions, (branches + 1) * numBatches * batchSize, [&] {
+        Graph graph = buildFanOut(branches);
+        return timeRun(graph, inputs, ExecutionMode::Parallel);
+    });
+
+    // memory-bound: the inputs of all tasks together don't fit in the last level cache
+    const size_t streamNodes = 4;
+    const size_t streamBatches = 256;
+    const size_t streamBatchSize = 8192;
+    const auto streamInputs = makeInputs(streamBatches, streamBatchSize);
+    const size_t streamElements = streamNodes * streamBatches * streamBatchSize;
+    benchmark("stream/prefetch", repetitions, streamElements, [&] {
+        Graph graph = buildStream(streamNodes);
+        return timeRun(graph, streamInputs, ExecutionMode::Parallel);
+    });
+    benchmark("stream/no-prefetch", repetitions, streamElements, [&] {
+        Graph graph = buildStream(streamNodes);
+        return timeRun(graph, streamInputs, ExecutionMode::Parallel, 0);
+    });
+
+    // contention at 64 threads: per-thread counters sharing cache lines or padded to their own
+    const size_t contentionThreads = 64;
+    const size_t increments = 1 << 20;
+    benchmark("counters/shared-line/64-threads", repetitions, contentionThreads * increments, [&] {
+        return timeCounters<SharedCounter>(contentionThreads, increments);
+    });
+    benchmark("counters/padded/64-threads", repetitions, contentionThreads * increments, [&] {
+        return timeCounters<PaddedCounter>(contentionThreads, increments);
+    });
+
+    // tiny tasks at 64 threads: dominated by the executor's shared state rather than by the nodes
+    const auto tinyInputs = makeInputs(numBatches, 1);
+    const size_t tinyBranches = 255;
+    benchmark("tiny-tasks/parallel/64-threads", repetitions, (tinyBranches + 1) * numBatches, [&] {
+        Graph graph = buildFanOut(tinyBranches);
+        return timeRun(graph, tinyInputs, ExecutionMode::Parallel, 256 * 1024, contentionThreads);
+    });
+
+    // tiny chain: every node waits for the previous one, coarsening queues one cluster per batch instead
+    const size_t tinyChainNodes = 64;
+    benchmark("tiny-chain/parallel", repetitions, tinyChainNodes * numBatches, [&] {
+        Graph graph = buildChain(tinyChainNodes, false);
+        return timeRun(graph, tinyInputs, ExecutionMode::Parallel);
+    });
+    benchmark("tiny-chain/parallel/coarsened", repetitions, tinyChainNodes * numBatches, [&] {
+        Graph graph = buildChain(tinyChainNodes, false);
+        for (size_t nodeId = 0; nodeId < graph.size(); ++nodeId) {
+            graph.getNode(nodeId).setCostEstimate(1e-6);
+        }
+        return timeRun(graph, tinyInputs, ExecutionMode::Parallel, 256 * 1024, 0, 1e-3);
+    });
+
+    // construction and compilation of a large graph, node by node or in bulk
+    const size_t largeNodes = 50000;
+    benchmark("build/incremental/50k-nodes", 1, largeNodes, [&] {
+        auto start = std::chrono::steady_clock::now();
+        Graph graph = buildChain(largeNodes, false);
+        graph.compile();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+    benchmark("build/bulk/50k-nodes", repetitions, largeNodes, [&] {
+        auto start = std::chrono::steady_clock::now();
+        Graph graph = buildChainInBulk(largeNodes);
+        graph.compile();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+
+    // request-path sized graph: latency of a whole run, setup included
+    const auto smallInputs = makeInputs(1, 16);
+    benchmark("small/auto", repetitions * 20, 2 * 16, [&] {
+        auto start = std::chrono::steady_clock::now();
+        Graph graph = buildChain(2, false);
+        Executor executor(graph, smallInputs);
+        executor.run();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    });
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/13
+
+/**
+ * @file buffer_allocator.cpp
+ *
+ * @brief Implements the allocation of MiniBatch buffers.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by buffer_allocator.h otherwise.
+ */
+
+#include "buffer_allocator.h"
+
+#include <atomic>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace buffer_pages_detail {
+
+/**
+ * @brief Bookkeeping stored in the 64 bytes in front of every buffer.
+ */
+struct BufferHeader {
+    void* mapping; ///< Start of the mapping, nullptr if the buffer comes from operator new.
+    size_t mappedBytes; ///< Length of the mapping.
+    size_t pageSize; ///< Page size obtained for the buffer.
+};
+
+static_assert(sizeof(BufferHeader) <= BufferPages::alignment, "Buffer header must fit in the alignment");
+
+DAG_INLINE std::atomic<HugePagePolicy>& policy() {
+    static std::atomic<HugePagePolicy> value{HugePagePolicy::None};
+    return value;
+}
+
+DAG_INLINE std::atomic<size_t>& minBytes() {
+    static std::atomic<size_t> value{2 * 1024 * 1024};
+    return value;
+}
+
+DAG_INLINE size_t regularPageSize() {
+#ifdef __linux__
+    static const size_t value = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return value;
+#else
+    return 4096;
+#endif
+}
+
+DAG_INLINE std::atomic<size_t>& lastPageSize() {
+    static std::atomic<size_t> value{regularPageSize()};
+    return value;
+}
+
+#ifdef __linux__
+// size of the pages reserved in hugetlbfs, 0 if unknown
+DAG_INLINE size_t hugeTlbPageSize() {
+    static const size_t value = [] {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        size_t kiloBytes = 0;
+        while (meminfo >> key) {
+            if (key == "Hugepagesize:" && meminfo >> kiloBytes) {
+                return kiloBytes * 1024;
+            }
+            meminfo.ignore(256, '\n');
+        }
+        return size_t(0);
+    }();
+    return value;
+}
+
+// size of the transparent huge pages, 0 if they are disabled
+DAG_INLINE size_t transparentPageSize() {
+    static const size_t value = [] {
+        std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string mode;
+        std::getline(enabled, mode);
+        if (mode.empty() || mode.find("[never]") != std::string::npos) {
+            return size_t(0);
+        }
+        size_t bytes = 2 * 1024 * 1024;
+        std::ifstream("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size") >> bytes;
+        return bytes;
+    }();
+    return value;
+}
+
+DAG_INLINE size_t roundUp(size_t bytes, size_t multiple) {
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+// maps at least bytes backed by huge pages, returns nullptr if the policy is None or the mapping fails
+DAG_INLINE void* mapHugePages(size_t bytes, HugePagePolicy policy, BufferHeader& header, size_t& pageSize) {
+    if (policy == HugePagePolicy::HugeTlb && hugeTlbPageSize() != 0) {
+        size_t length = roundUp(bytes, hugeTlbPageSize());
+        void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping != MAP_FAILED) {
+            header = BufferHeader{mapping, length, hugeTlbPageSize()};
+            pageSize = hugeTlbPageSize();
+            return mapping;
+        }
+    }
+    if (policy == HugePagePolicy::None) {
+        return nullptr;
+    }
+
+    // over-map by one huge page and trim, so that the buffer starts on a huge page boundary
+    size_t hugePage = transparentPageSize() != 0 ? transparentPageSize() : 2 * 1024 * 1024;
+    size_t length = roundUp(bytes, hugePage);
+    void* mapping = mmap(nullptr, length + hugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    char* begin = static_cast<char*>(mapping);
+    char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<size_t>(begin), hugePage));
+    if (aligned != begin) {
+        munmap(begin, aligned - begin);
+    }
+    if (aligned + length != begin + length + hugePage) {
+        munmap(aligned + length, begin + hugePage - aligned);
+    }
+    bool advised = madvise(aligned, length, MADV_HUGEPAGE) == 0;
+    pageSize = advised && transparentPageSize() != 0 ? hugePage : regularPageSize();
+    header = BufferHeader{aligned, length, pageSize};
+    return aligned;
+}
+#endif
+
+} // namespace buffer_pages_detail
+
+DAG_INLINE void BufferPages::setPolicy(HugePagePolicy policy, size_t minBytes) {
+    buffer_pages_detail::policy().store(policy);
+    buffer_pages_detail::minBytes().store(minBytes);
+}
+
+DAG_INLINE HugePagePolicy BufferPages::policy() {
+    return buffer_pages_detail::policy().load();
+}
+
+DAG_INLINE size_t BufferPages::pageSize() {
+    return buffer_pages_detail::lastPageSize().load(std::memory_order_relaxed);
+}
+
+DAG_INLINE size_t BufferPages::pageSize(const void* buffer) {
+    using namespace buffer_pages_detail;
+    if (buffer == nullptr) {
+        return regularPageSize();
+    }
+    return reinterpret_cast<const BufferHeader*>(static_cast<const char*>(buffer) - alignment)->pageSize;
+}
+
+DAG_INLINE void* BufferPages::allocate(size_t bytes) {
+    using namespace buffer_pages_detail;
+    // the header takes a whole alignment unit, so that the buffer behind it stays aligned
+    size_t total = bytes + alignment;
+    if (bytes >= minBytes().load(std::memory_order_relaxed)) {
+        size_t obtained = regularPageSize();
+#ifdef __linux__
+        // qualified: the member BufferPages::policy() hides the detail function
+        HugePagePolicy current = buffer_pages_detail::policy().load(std::memory_order_relaxed);
+        BufferHeader header{};
+        void* mapping = mapHugePages(total, current, header, obtained);
+        if (mapping != nullptr) {
+            lastPageSize().store(obtained, std::memory_order_relaxed);
+            *static_cast<BufferHeader*>(mapping) = header;
+            return static_cast<char*>(mapping) + alignment;
+        }
+#endif
+        lastPageSize().store(obtained, std::memory_order_relaxed);
+    }
+    void* memory = ::operator new(total, std::align_val_t(alignment));
+    *static_cast<BufferHeader*>(memory) = BufferHeader{nullptr, 0, regularPageSize()};
+    return static_cast<char*>(memory) + alignment;
+}
+
+DAG_INLINE void BufferPages::deallocate(void* buffer) noexcept {
+    using namespace buffer_pages_detail;
+    if (buffer == nullptr) {
+        return;
+    }
+    void* memory = static_cast<char*>(buffer) - alignment;
+    BufferHeader header = *static_cast<BufferHeader*>(memory);
+#ifdef __linux__
+    if (header.mapping != nullptr) {
+        munmap(header.mapping, header.mappedBytes);
+        return;
+    }
+#endif
+    ::operator delete(memory, std::align_val_t(alignment));
+}
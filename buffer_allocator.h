@@ -0,0 +1,131 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/13
+
+/**
+ * @file buffer_allocator.h
+ *
+ * @brief Aligned and huge page backed allocation of MiniBatch buffers.
+ *
+ * Every MiniBatch buffer is aligned to 64 bytes so that SIMD kernels can use aligned loads. Buffers of
+ * at least the huge page threshold can additionally be backed by 2 MB pages, which removes most TLB
+ * misses when streaming over multi-GB MiniBatches. The huge page policy is process-wide.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include "dag_config.h"
+
+/**
+ * @brief How large MiniBatch buffers are backed.
+ */
+enum class HugePagePolicy {
+    None, ///< Regular pages.
+    Transparent, ///< Transparent huge pages, requested with madvise(MADV_HUGEPAGE).
+    HugeTlb ///< Pages reserved in hugetlbfs, falling back to transparent huge pages if none is free.
+};
+
+/**
+ * @brief Process-wide allocation of the MiniBatch buffers.
+ */
+class BufferPages {
+public:
+    static constexpr size_t alignment = 64; ///< Alignment of every buffer, in bytes.
+
+    /**
+     * @brief Sets how buffers are backed from now on. Buffers already allocated are not moved.
+     *
+     * @param policy The huge page policy, HugePagePolicy::None by default.
+     * @param minBytes Size from which a buffer is backed by huge pages, 2 MB by default.
+     */
+    static void setPolicy(HugePagePolicy policy, size_t minBytes = 2 * 1024 * 1024);
+
+    /**
+     * @brief Gets the current huge page policy.
+     *
+     * @return The huge page policy.
+     */
+    static HugePagePolicy policy();
+
+    /**
+     * @brief Page size obtained by the most recent buffer of at least the huge page threshold.
+     *
+     * For transparent huge pages, this is the huge page size when the kernel accepted the request and
+     * has them enabled; the kernel may still back part of the buffer with regular pages.
+     *
+     * @return The page size in bytes, the regular page size if no large buffer has been allocated.
+     */
+    static size_t pageSize();
+
+    /**
+     * @brief Page size backing a buffer, as obtained when it was allocated.
+     *
+     * Unlike pageSize(), this doesn't depend on the allocations made by other threads since.
+     *
+     * @param buffer A buffer returned by allocate(), or nullptr.
+     * @return The page size in bytes, the regular page size for nullptr and buffers from operator new.
+     */
+    static size_t pageSize(const void* buffer);
+
+    /**
+     * @brief Allocates a buffer aligned to 64 bytes.
+     *
+     * @param bytes The size of the buffer.
+     * @return The buffer.
+     * @throws std::bad_alloc If the memory cannot be allocated.
+     */
+    static void* allocate(size_t bytes);
+
+    /**
+     * @brief Frees a buffer returned by allocate().
+     *
+     * @param buffer The buffer.
+     */
+    static void deallocate(void* buffer) noexcept;
+};
+
+/**
+ * @brief Standard allocator of MiniBatch buffers, see BufferPages.
+ *
+ * The allocator is stateless: storage may be swapped between any two MiniBatches.
+ *
+ * @tparam T The element type.
+ */
+template <typename T>
+class BufferAllocator {
+public:
+    using value_type = T;
+
+    BufferAllocator() = default;
+
+    template <typename U>
+    BufferAllocator(const BufferAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(BufferPages::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* buffer, size_t) noexcept {
+        BufferPages::deallocate(buffer);
+    }
+
+    template <typename U>
+    bool operator==(const BufferAllocator<U>&) const noexcept {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const BufferAllocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "buffer_allocator.cpp"
+#endif
@@ -0,0 +1,193 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/10
+
+/**
+ * @file concurrency.cpp
+ *
+ * @brief Implements the detection of the CPU limits of the process.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by concurrency.h otherwise.
+ */
+
+#include "concurrency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+    #include <sched.h>
+#endif
+
+namespace concurrency_detail {
+
+#ifdef __linux__
+DAG_INLINE size_t affinityCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return 0;
+    }
+    return static_cast<size_t>(CPU_COUNT(&set));
+}
+
+/**
+ * @brief A cgroup hierarchy mounted in the file system.
+ */
+struct CgroupMount {
+    std::string root; ///< Path of the mounted directory inside the hierarchy.
+    std::string mountPoint; ///< Where the hierarchy is mounted.
+};
+
+DAG_INLINE std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+// finds the mount of the cgroup2 hierarchy, or of the cgroup v1 hierarchy holding the cpu controller
+DAG_INLINE bool findMount(bool unified, CgroupMount& mount) {
+    std::ifstream mountInfo("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(mountInfo, line)) {
+        // id parent major:minor root mount-point options [optional fields] - type source super-options
+        size_t separator = line.find(" - ");
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::istringstream head(line.substr(0, separator));
+        std::istringstream tail(line.substr(separator + 3));
+        std::string id, parent, device, type, source, superOptions;
+        head >> id >> parent >> device >> mount.root >> mount.mountPoint;
+        tail >> type >> source >> superOptions;
+        if (unified && type == "cgroup2") {
+            return true;
+        }
+        if (!unified && type == "cgroup") {
+            auto options = split(superOptions, ',');
+            if (std::find(options.begin(), options.end(), "cpu") != options.end()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// path of the process' cgroup in the cgroup2 hierarchy, or in the v1 hierarchy of the cpu controller
+DAG_INLINE bool findCgroup(bool unified, std::string& path) {
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line)) {
+        // hierarchy-id:controllers:path
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        auto names = split(controllers, ',');
+        if ((unified && line.compare(0, first, "0") == 0 && controllers.empty())
+            || (!unified && std::find(names.begin(), names.end(), "cpu") != names.end())) {
+            path = line.substr(second + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// CPUs granted by the quota of one cgroup directory, 0 if it has none
+DAG_INLINE double readQuota(const std::string& directory, bool unified) {
+    double quota = 0.0;
+    double period = 0.0;
+    if (unified) {
+        std::ifstream cpuMax(directory + "/cpu.max");
+        std::string limit;
+        if (!(cpuMax >> limit >> period) || limit == "max") {
+            return 0.0;
+        }
+        quota = std::atof(limit.c_str());
+    } else {
+        std::ifstream(directory + "/cpu.cfs_quota_us") >> quota;
+        std::ifstream(directory + "/cpu.cfs_period_us") >> period;
+    }
+    return quota > 0.0 && period > 0.0 ? quota / period : 0.0;
+}
+
+// smallest quota of the process' cgroup and its ancestors, 0 if none of them has one
+DAG_INLINE double cgroupCpus(bool unified) {
+    CgroupMount mount;
+    std::string path;
+    if (!findMount(unified, mount) || !findCgroup(unified, path)) {
+        return 0.0;
+    }
+    // inside a cgroup namespace the mount root is the process' own cgroup
+    if (mount.root != "/" && path.compare(0, mount.root.size(), mount.root) == 0) {
+        path = path.substr(mount.root.size());
+    }
+    double cpus = 0.0;
+    while (true) {
+        double quota = readQuota(mount.mountPoint + path, unified);
+        if (quota > 0.0) {
+            cpus = cpus > 0.0 ? std::min(cpus, quota) : quota;
+        }
+        size_t slash = path.find_last_of('/');
+        if (path.empty() || slash == std::string::npos) {
+            break;
+        }
+        path = path.substr(0, slash);
+    }
+    return cpus;
+}
+#endif
+
+DAG_INLINE size_t overrideThreads() {
+    const char* value = std::getenv("DAG_NUM_THREADS");
+    if (value == nullptr) {
+        return 0;
+    }
+    char* end = nullptr;
+    unsigned long threads = std::strtoul(value, &end, 10);
+    return end != value && *end == '\0' ? static_cast<size_t>(threads) : 0;
+}
+
+} // namespace concurrency_detail
+
+DAG_INLINE ConcurrencyInfo detectConcurrency() {
+    using namespace concurrency_detail;
+    ConcurrencyInfo info;
+    info.hardwareThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+#ifdef __linux__
+    info.affinityCpus = affinityCpus();
+    double unified = cgroupCpus(true);
+    double legacy = cgroupCpus(false);
+    info.cgroupCpus = unified > 0.0 && legacy > 0.0 ? std::min(unified, legacy) : std::max(unified, legacy);
+#endif
+    info.overrideThreads = overrideThreads();
+
+    size_t workers = info.hardwareThreads;
+    if (info.affinityCpus != 0) {
+        workers = std::min(workers, info.affinityCpus);
+    }
+    if (info.cgroupCpus > 0.0) {
+        // rounded up, so that a fractional quota isn't left unused
+        workers = std::min(workers, static_cast<size_t>(std::ceil(info.cgroupCpus)));
+    }
+    info.workers = std::max<size_t>(1, info.overrideThreads != 0 ? info.overrideThreads : workers);
+    return info;
+}
+
+DAG_INLINE size_t defaultWorkerCount() {
+    static const size_t workers = detectConcurrency().workers;
+    return workers;
+}
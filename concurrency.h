@@ -0,0 +1,49 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/10
+
+/**
+ * @file concurrency.h
+ *
+ * @brief Detects how many worker threads the process can actually run in parallel.
+ *
+ * std::thread::hardware_concurrency() reports every CPU of the host, even when the process is pinned to
+ * a few of them or a container's cgroup only grants a fraction of the machine. The default worker count
+ * honors the CPU affinity mask and the cgroup v1 and v2 CPU quota, and can be overridden with the
+ * DAG_NUM_THREADS environment variable.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include "dag_config.h"
+
+/**
+ * @brief The CPU limits seen by the process.
+ */
+struct ConcurrencyInfo {
+    size_t hardwareThreads = 1; ///< CPUs reported by std::thread::hardware_concurrency().
+    size_t affinityCpus = 0; ///< CPUs in the affinity mask, 0 if unknown.
+    double cgroupCpus = 0.0; ///< CPU quota divided by its period, 0 if there is no quota.
+    size_t overrideThreads = 0; ///< Worker count set by DAG_NUM_THREADS, 0 if unset.
+    size_t workers = 1; ///< Resulting worker count: the override, or the smallest limit rounded up.
+};
+
+/**
+ * @brief Reads the CPU limits of the process.
+ *
+ * @return The limits and the worker count they allow, at least 1.
+ */
+ConcurrencyInfo detectConcurrency();
+
+/**
+ * @brief Worker count used when none is set explicitly, detected once per process.
+ *
+ * @return The worker count of detectConcurrency().
+ */
+size_t defaultWorkerCount();
+
+#ifdef DAG_HEADER_ONLY
+    #include "concurrency.cpp"
+#endif
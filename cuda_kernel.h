@@ -0,0 +1,31 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/6
+
+/**
+ * @file cuda_kernel.h
+ *
+ * @brief Declares the CUDA processing of GPU nodes.
+ *
+ * The kernels are implemented in cuda_kernel.cu, which must be compiled by nvcc and linked into
+ * programs built with USE_CUDA.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "graph_node.h"
+#include "mini_batch.h"
+
+/**
+ * @brief Runs the CUDA kernel of a GPU node on its input MiniBatches.
+ *
+ * @param node The GPU node.
+ * @param inputMiniBatches The input MiniBatches of the node.
+ * @param outputMiniBatches Filled with the output MiniBatches of the node.
+ * @param outputName The name of the output field.
+ */
+void runCudaProcess(GraphNode& node, const std::vector<MiniBatch>& inputMiniBatches,
+                    std::vector<MiniBatch>& outputMiniBatches, const std::string outputName);
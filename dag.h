@@ -1,13 +1,31 @@
-// Copyright (C) 2024 Haochen Jiang
-//
-// Authors: Haochen Jiang
-// Date: 2024/1/2
-
-/** @file dag.h
- *  @brief DAG entrance file, include this file to use the DAG library.
- */
-
-#pragma once
-
-// Executor of the graph
-#include "executor.h"
\ No newline at end of file
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/1/2
+
+/** @file dag.h
+ *  @brief DAG entrance file, include this file to use the DAG library.
+ */
+
+#pragma once
+
+// Executor of the graph
+#include "executor.h"
+
+// Child tasks spawned from node bodies into the executor's workers
+#include "task_group.h"
+
+// Construction of large graphs from nodes and edges given in bulk
+#include "graph_builder.h"
+
+// Calibration of the executor parameters, persisted per workload
+#include "autotuner.h"
+
+// Expression nodes evaluated column at a time
+#include "expression.h"
+
+// Nodes iterating a subgraph to a fixed point
+#include "loop_node.h"
+
+// DOT and JSON export of the graph annotated with executor statistics
+#include "graph_export.h"
\ No newline at end of file
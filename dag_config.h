@@ -0,0 +1,32 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/6
+
+/**
+ * @file dag_config.h
+ *
+ * @brief Selects between the header-only and the compiled library mode.
+ *
+ * By default the library is header-only: every header includes the .cpp file holding its
+ * implementation and the functions are inline. Defining DAG_COMPILED_LIB compiles the .cpp files once
+ * into a library instead, so that including dag.h doesn't rebuild the graph algorithms and the executor
+ * in every translation unit.
+ *
+ * DAG_CACHE_LINE_SIZE is the alignment used to keep state written by different threads on separate
+ * cache lines, 64 bytes unless defined otherwise.
+ */
+
+#pragma once
+
+#ifdef DAG_COMPILED_LIB
+    #undef DAG_HEADER_ONLY
+    #define DAG_INLINE
+#else
+    #define DAG_HEADER_ONLY
+    #define DAG_INLINE inline
+#endif
+
+#ifndef DAG_CACHE_LINE_SIZE
+    #define DAG_CACHE_LINE_SIZE 64
+#endif
@@ -1,48 +1,102 @@
-// Copyright (C) 2024 Haochen Jiang
-//
-// Authors: Haochen Jiang
-// Date: 2024/1/2
-
-/** 
- * @file data_container.h
- *
- * @brief Defines a versatile data container for various data types.
- *
- * This file contains the definition of DataContainer, a flexible and type-safe container
- * capable of holding a variety of basic and complex data types. It is based on the C++17
- * std::variant feature for managing a set of typed values efficiently and safely.
- */
-#pragma once
-
-#include <variant>
-#include <vector>
-#include <string>
-
-/**
- * @brief Defines a versatile data container.
- *
- * This type definition uses std::variant to encapsulate a variety of data types.
- * It is designed to be a flexible container for data of different types,
- * including basic data types (int, float, etc.), their long and unsigned variants,
- * strings, and vectors of these types.
- *
- * @note std::variant is a C++17 feature, ensuring type safety and efficient management
- *       of a set of typed values.
- */
-using DataContainer = std::variant<
-    int,
-    long,
-    long long,
-    unsigned int,
-    unsigned long,
-    unsigned long long,
-    float,
-    double,
-    long double,
-    std::string,
-    std::vector<int>,
-    std::vector<long>,
-    std::vector<float>,
-    std::vector<double>,
-    std::vector<std::string>
->;
\ No newline at end of file
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/1/2
+
+/** 
+ * @file data_container.h
+ *
+ * @brief Defines a versatile data container for various data types.
+ *
+ * This file contains the definition of DataContainer, a flexible and type-safe container
+ * capable of holding a variety of basic and complex data types. It is based on the C++17
+ * std::variant feature for managing a set of typed values efficiently and safely.
+ */
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <string>
+
+/**
+ * @brief Defines a versatile data container.
+ *
+ * This type definition uses std::variant to encapsulate a variety of data types.
+ * It is designed to be a flexible container for data of different types,
+ * including basic data types (int, float, etc.), their long and unsigned variants,
+ * strings, and vectors of these types.
+ *
+ * @note std::variant is a C++17 feature, ensuring type safety and efficient management
+ *       of a set of typed values.
+ */
+using DataContainer = std::variant<
+    int,
+    long,
+    long long,
+    unsigned int,
+    unsigned long,
+    unsigned long long,
+    float,
+    double,
+    long double,
+    std::string,
+    std::vector<int>,
+    std::vector<long>,
+    std::vector<float>,
+    std::vector<double>,
+    std::vector<std::string>
+>;
+
+/**
+ * @brief The type of a field: the index of a DataContainer alternative.
+ */
+using FieldType = size_t;
+
+/**
+ * @brief The type of a field whose type has not been declared, compatible with every type.
+ */
+constexpr FieldType untypedField = std::variant_npos;
+
+namespace data_container_detail {
+
+template <typename T, size_t... Indices>
+constexpr FieldType indexOf(std::index_sequence<Indices...>) {
+    FieldType index = untypedField;
+    ((std::is_same_v<T, std::variant_alternative_t<Indices, DataContainer>> ? (index = Indices, true) : false) || ...);
+    return index;
+}
+
+} // namespace data_container_detail
+
+/**
+ * @brief Gets the field type of a DataContainer alternative.
+ *
+ * @tparam T One of the types held by DataContainer.
+ * @return The field type of T.
+ */
+template <typename T>
+constexpr FieldType fieldTypeOf() {
+    constexpr FieldType index =
+        data_container_detail::indexOf<T>(std::make_index_sequence<std::variant_size_v<DataContainer>>());
+    static_assert(index != untypedField, "T is not a DataContainer type");
+    return index;
+}
+
+/**
+ * @brief Gets a readable name of a field type, for error messages.
+ *
+ * @param type The field type.
+ * @return The name of the type.
+ */
+inline const char* fieldTypeName(FieldType type) {
+    static const char* const names[] = {
+        "int", "long", "long long", "unsigned int", "unsigned long", "unsigned long long", "float", "double",
+        "long double", "std::string", "std::vector<int>", "std::vector<long>", "std::vector<float>",
+        "std::vector<double>", "std::vector<std::string>"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == std::variant_size_v<DataContainer>, "Missing type name");
+    return type < std::variant_size_v<DataContainer> ? names[type] : "untyped";
+}
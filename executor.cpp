@@ -0,0 +1,715 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/6
+
+/**
+ * @file executor.cpp
+ *
+ * @brief Implements the Executor class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by executor.h otherwise.
+ */
+
+#include "executor.h"
+
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+
+#ifdef DAG_COMPILED_LIB
+// the task queue of the executor
+template class ThreadSafeQueue<std::pair<size_t, size_t>>;
+#endif
+
+DAG_INLINE void Executor::run() {
+    beginCall();
+    m_inline = runsInline();
+    std::vector<ScheduleStep> order = m_schedule;
+    if (order.empty() && m_inline) {
+        for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
+            for (size_t nodeId : m_graph.getTopologicalOrder()) {
+                order.push_back({nodeId, batchId});
+            }
+        }
+    } else if (order.empty()) {
+        for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+            for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
+                order.push_back({nodeId, batchId});
+            }
+        }
+    }
+
+    // tasks already computed by evaluate() are not run again
+    std::vector<ScheduleStep> tasks;
+    for (const auto& task : order) {
+        if (!taskDone(task.first, task.second)) {
+            tasks.push_back(task);
+        }
+    }
+    if (m_inline && !m_schedule.empty()) {
+        tasks = readyOrder(tasks);
+    }
+    executeTasks(tasks, true);
+}
+
+DAG_INLINE std::vector<ScheduleStep> Executor::readyOrder(const std::vector<ScheduleStep>& tasks) {
+    // Kahn's algorithm taking the earliest ready task of the schedule first
+    const size_t never = std::numeric_limits<size_t>::max();
+    std::vector<size_t> position(m_numTasks, never);
+    std::vector<size_t> pending(m_numTasks, 0);
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        position[tasks[i].second * m_graph.size() + tasks[i].first] = i;
+    }
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        size_t index = tasks[i].second * m_graph.size() + tasks[i].first;
+        for (size_t predecessor : m_graph.getPredecessors(tasks[i].first)) {
+            pending[index] += taskDone(predecessor, tasks[i].second) ? 0 : 1;
+        }
+        if (pending[index] == 0) {
+            ready.push(i);
+        }
+    }
+    std::vector<ScheduleStep> order;
+    order.reserve(tasks.size());
+    while (!ready.empty()) {
+        ScheduleStep task = tasks[ready.top()];
+        ready.pop();
+        order.push_back(task);
+        for (size_t successor : m_graph.getSuccessors(task.first)) {
+            size_t index = task.second * m_graph.size() + successor;
+            if (position[index] != never && --pending[index] == 0) {
+                ready.push(position[index]);
+            }
+        }
+    }
+    return order;
+}
+
+DAG_INLINE void Executor::beginCall() {
+    m_runStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < m_numTasks; ++i) {
+        if (m_taskStates[i].done) {
+            // tasks of an earlier evaluate() are already recorded against the start of the pass
+            return;
+        }
+    }
+    m_passStart = m_runStart;
+    if (m_recording != nullptr) {
+        m_recording->capture(m_graph, m_inputBatches);
+    }
+}
+
+DAG_INLINE const MiniBatch& Executor::evaluate(size_t nodeId, const std::string& field, size_t batchId) {
+    const GraphNode& node = m_graph.getNode(nodeId);
+    if (batchId >= m_inputBatches.size()) {
+        throw std::out_of_range("Batch ID out of range.");
+    }
+    if (node.getOutputs().find(field) == node.getOutputs().end()) {
+        throw std::invalid_argument("Field '" + field + "' is not an output of node " + std::to_string(nodeId) + ".");
+    }
+    const BufferSlot* slot = findBufferSlot(nodeId, field);
+    if (slot != nullptr && !slot->retained) {
+        throw std::logic_error("Field '" + field + "' of node " + std::to_string(nodeId)
+                               + " is consumed and released by buffer reuse.");
+    }
+
+    if (!taskDone(nodeId, batchId)) {
+        beginCall();
+        m_inline = runsInline();
+
+        // walking the topological order backwards, every needed node marks its missing predecessors
+        const auto& order = m_graph.getTopologicalOrder();
+        std::vector<bool> needed(m_graph.size(), false);
+        needed[nodeId] = true;
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (!needed[*it]) {
+                continue;
+            }
+            for (size_t predecessor : m_graph.getPredecessors(*it)) {
+                needed[predecessor] = needed[predecessor] || !taskDone(predecessor, batchId);
+            }
+        }
+        std::vector<ScheduleStep> tasks;
+        for (size_t ancestor : order) {
+            if (needed[ancestor]) {
+                tasks.push_back({ancestor, batchId});
+            }
+        }
+        executeTasks(tasks, false);
+    }
+    return m_graph.getMiniBatch(nodeId, batchId, field);
+}
+
+DAG_INLINE void Executor::executeTasks(const std::vector<ScheduleStep>& tasks, bool coarsen) {
+    m_clusters = TaskClusters();
+    if (coarsen && !m_inline && m_grainSeconds > 0.0) {
+        m_clusters = m_graph.coarsen(taskCosts(), m_grainSeconds);
+    }
+    WorkerState workerState;
+    workerState.nodes.assign(m_graph.size(), NodeStats());
+    m_workers.assign(m_inline ? 1 : getNumThreads(), workerState);
+    if (m_inline) {
+        runInline(tasks);
+    } else {
+        initializeTaskQueue(tasks);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            workers.emplace_back(&Executor::workerThread, this, i);
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    mergeWorkerStates();
+    m_stats.wallSeconds += secondsSince(m_runStart);
+    m_stats.pageSize = largestPageSize();
+}
+
+DAG_INLINE size_t Executor::largestPageSize() {
+    // only the buffers of this executor: other executors may allocate concurrently
+    size_t pageSize = BufferPages::pageSize(nullptr);
+    for (const auto& storage : m_bufferPool) {
+        pageSize = std::max(pageSize, BufferPages::pageSize(storage.data()));
+    }
+    for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+        for (const auto& batchMap : m_graph.getNodeMiniBatches(nodeId)) {
+            for (const auto& field : batchMap) {
+                pageSize = std::max(pageSize, BufferPages::pageSize(field.second.getData().data()));
+            }
+        }
+    }
+    return pageSize;
+}
+
+DAG_INLINE std::vector<double> Executor::taskCosts() const {
+    std::vector<double> costs(m_graph.size(), std::numeric_limits<double>::infinity());
+    for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+        const NodeStats& stats = m_stats.nodes[nodeId];
+        if (stats.invocations != 0) {
+            costs[nodeId] = stats.seconds / static_cast<double>(stats.invocations);
+        } else if (m_graph.getNode(nodeId).getCostEstimate() > 0.0) {
+            costs[nodeId] = m_graph.getNode(nodeId).getCostEstimate();
+        }
+    }
+    return costs;
+}
+
+DAG_INLINE bool Executor::runsInline() const {
+    if (m_executionMode != ExecutionMode::Auto) {
+        return m_executionMode == ExecutionMode::Inline;
+    }
+    size_t elements = 0;
+    for (const auto& batchMap : m_inputBatches) {
+        for (const auto& inputField : batchMap) {
+            elements += inputField.second.size();
+        }
+    }
+    return getNumThreads() == 1 || elements * m_graph.size() < m_inlineThreshold;
+}
+
+DAG_INLINE void Executor::setSchedule(const std::vector<ScheduleStep>& schedule) {
+    if (schedule.empty()) {
+        m_schedule.clear();
+        return;
+    }
+    if (schedule.size() != m_graph.size() * m_inputBatches.size()) {
+        throw std::invalid_argument("Schedule must contain every task exactly once.");
+    }
+    std::vector<bool> seen(schedule.size(), false);
+    for (const auto& task : schedule) {
+        if (task.first >= m_graph.size() || task.second >= m_inputBatches.size()) {
+            throw std::invalid_argument("Schedule step (" + std::to_string(task.first) + ", " + std::to_string(task.second)
+                                        + ") is out of range.");
+        }
+        size_t index = task.second * m_graph.size() + task.first;
+        if (seen[index]) {
+            throw std::invalid_argument("Schedule step (" + std::to_string(task.first) + ", " + std::to_string(task.second)
+                                        + ") appears twice.");
+        }
+        seen[index] = true;
+    }
+    m_schedule = schedule;
+}
+
+DAG_INLINE void Executor::initialize() {
+    if (!m_graph.isCompiled()) {
+        std::cout << "Compile Graph" << std::endl;
+        m_graph.compile();
+    }
+    validateInputBatches();
+    m_bufferPool.assign(m_graph.getBufferAssignment().numBuffers, MiniBatchData());
+    m_stats.nodes.assign(m_graph.size(), NodeStats());
+    size_t numTasks = m_graph.size() * m_inputBatches.size();
+    m_numTasks = numTasks;
+    m_taskStates.reset(new TaskState[numTasks]);
+    for (size_t i = 0; i < numTasks; ++i) {
+        m_taskStates[i].done = false;
+    }
+
+    std::cout << "Initialize MiniBatches in Graph" << std::endl;
+    m_graph.initMiniBatches(m_inputBatches.size());
+
+    std::cout << "Filling input MiniBatches for root nodes" << std::endl;
+    fillRootInputs();
+}
+
+DAG_INLINE void Executor::reset(bool validateTypes) {
+    size_t numTasks = m_graph.size() * m_inputBatches.size();
+    if (numTasks != m_numTasks) {
+        throw std::logic_error("The number of input batches changed since the executor was created.");
+    }
+    validateInputBatches(validateTypes);
+    for (size_t i = 0; i < numTasks; ++i) {
+        m_taskStates[i].done = false;
+    }
+    // element-wise nodes append to their outputs, which keep their capacity for the next run
+    for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+        for (const auto& outputField : m_graph.getNode(nodeId).getOutputs()) {
+            for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
+                m_graph.getMiniBatch(nodeId, batchId, outputField.first).clear();
+            }
+        }
+    }
+    fillRootInputs();
+}
+
+DAG_INLINE void Executor::fillRootInputs() {
+    for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
+        const auto& batchMap = m_inputBatches[batchId];
+        for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+            if (m_graph.isRoot(nodeId)) {
+                auto& nodeBatches = m_graph.getNodeMiniBatches(nodeId);
+                for (const auto& inputField : batchMap) {
+                    nodeBatches[batchId][inputField.first] = inputField.second;
+                }
+            }
+        }
+    }
+}
+
+DAG_INLINE void Executor::validateInputBatches(bool checkTypes) const {
+    for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
+        const auto& batchMap = m_inputBatches[batchId];
+        for (size_t nodeId : m_graph.getRootNodes()) {
+            const GraphNode& node = m_graph.getNode(nodeId);
+            for (const auto& inputField : node.getInputs()) {
+                auto it = batchMap.find(inputField.first);
+                if (it == batchMap.end()) {
+                    if (node.isInputRequired(inputField.first)) {
+                        throw std::invalid_argument("Input batch " + std::to_string(batchId) + " is missing field '"
+                                                    + inputField.first + "' of node " + std::to_string(nodeId) + ".");
+                    }
+                    continue;
+                }
+                // once here, so that processing functions don't have to check every element
+                FieldType type = node.getInputType(inputField.first);
+                if (type == untypedField || !checkTypes) {
+                    continue;
+                }
+                const MiniBatch& batch = it->second;
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    const DataContainer& element = batch.getData(i);
+                    if (element.index() != type && batch.isValid(i)) {
+                        throw std::invalid_argument("Field '" + inputField.first + "' of input batch "
+                                                    + std::to_string(batchId) + " holds an element of type "
+                                                    + fieldTypeName(element.index()) + ", node "
+                                                    + std::to_string(nodeId) + " expects " + fieldTypeName(type) + ".");
+                    }
+                }
+            }
+        }
+    }
+}
+
+DAG_INLINE void Executor::initializeTaskQueue(const std::vector<ScheduleStep>& tasks) {
+    // only the predecessors that haven't run yet are waited for
+    for (const auto& task : tasks) {
+        size_t pending = 0;
+        for (size_t predecessor : m_graph.getPredecessors(task.first)) {
+            pending += taskDone(predecessor, task.second) ? 0 : 1;
+        }
+        pendingPredecessors(task.first, task.second).store(pending);
+    }
+    size_t queued = 0;
+    for (const auto& task : tasks) {
+        if (m_clusters.isHead(task.first)
+            || taskDone(m_clusters.members[m_clusters.clusterOf[task.first]].front(), task.second)) {
+            m_taskQueue.push(task);
+            ++queued;
+        }
+    }
+    m_stats.scheduledTasks += queued;
+    m_remainingTasks.store(queued);
+    m_taskPool.open(queued == 0);
+}
+
+DAG_INLINE void Executor::workerThread(size_t workerId) {
+    TaskPool::Scope scope(&m_taskPool);
+    if (!m_hardwareCounters) {
+        processQueue(workerId);
+        return;
+    }
+    // counters count the thread that opens them
+    PerfCounters counters;
+    m_workers[workerId].counters = counters.available() ? &counters : nullptr;
+    processQueue(workerId);
+    m_workers[workerId].counters = nullptr;
+}
+
+DAG_INLINE void Executor::processQueue(size_t workerId) {
+    std::pair<size_t, size_t> task;
+    std::pair<size_t, size_t> next;
+    bool hasNext = false;
+    while (hasNext || m_taskQueue.try_pop(task)) {
+        // children spawned by running nodes come first, their parents wait for them
+        while (m_taskPool.tryRun()) {
+        }
+        if (hasNext) {
+            task = next;
+            hasNext = false;
+        } else if (!isReady(task)) {
+            // every MiniBatch exists since initMiniBatches, readiness is tracked by the predecessors left
+            m_taskQueue.push(task); // Task not ready, requeue it
+            continue;
+        }
+
+        // look one task ahead and warm up its inputs while the current task runs
+        if (m_prefetchLimit != 0 && m_taskQueue.try_pop(next)) {
+            if (isReady(next)) {
+                prefetchInputs(next.first, next.second);
+                hasNext = true;
+            } else {
+                m_taskQueue.push(next);
+            }
+        }
+
+        executeQueuedTask(task.first, task.second, workerId);
+        if (m_remainingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_taskPool.close();
+        }
+    }
+    // every task is taken, help the nodes still running with their children
+    while (m_taskPool.runOrWait()) {
+    }
+}
+
+DAG_INLINE void Executor::prefetchInputs(size_t nodeId, size_t batchId) {
+    size_t budget = m_prefetchLimit;
+    for (const auto& inputField : m_graph.getNode(nodeId).getInputs()) {
+        const auto& data = m_graph.getMiniBatch(nodeId, batchId, inputField.first).getData();
+        const char* begin = reinterpret_cast<const char*>(data.data());
+        size_t bytes = std::min(budget, data.size() * sizeof(DataContainer));
+        for (size_t offset = 0; offset < bytes; offset += DAG_CACHE_LINE_SIZE) {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(begin + offset, 0, 3);
+#else
+            (void)begin;
+#endif
+        }
+        budget -= bytes;
+    }
+}
+
+DAG_INLINE void Executor::runInline(const std::vector<ScheduleStep>& tasks) {
+    // nested in a node of another run, child tasks keep going to the workers of that run
+    TaskPool::Scope scope(TaskPool::current() != nullptr ? TaskPool::current() : &m_taskPool);
+    std::unique_ptr<PerfCounters> counters;
+    if (m_hardwareCounters) {
+        counters = std::make_unique<PerfCounters>();
+        m_workers[0].counters = counters->available() ? counters.get() : nullptr;
+    }
+    for (const auto& task : tasks) {
+        executeTask(task.first, task.second, 0);
+    }
+    m_workers[0].counters = nullptr;
+}
+
+DAG_INLINE void Executor::executeTask(size_t nodeId, size_t batchId, size_t workerId) {
+    NodeStats taskStats;
+    taskStats.invocations = 1;
+    for (const auto& inputField : m_graph.getNode(nodeId).getInputs()) {
+        const auto& inputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, inputField.first);
+        taskStats.elements = std::max(taskStats.elements, inputMiniBatch.size());
+        taskStats.bytesIn += ExecutorStats::bytesOf(inputMiniBatch);
+    }
+
+    PerfCounters* counters = m_workers[workerId].counters;
+    CounterValues before;
+    bool counted = counters != nullptr && counters->read(before);
+    auto start = std::chrono::steady_clock::now();
+    executeNode(nodeId, batchId);
+    taskStats.seconds = secondsSince(start);
+    CounterValues after;
+    if (counted && counters->read(after)) {
+        // scaled values of a multiplexed group may step back slightly
+        auto delta = [](uint64_t to, uint64_t from) { return to > from ? to - from : 0; };
+        taskStats.countedElements = taskStats.elements;
+        taskStats.counters.cycles = delta(after.cycles, before.cycles);
+        taskStats.counters.instructions = delta(after.instructions, before.instructions);
+        taskStats.counters.llcMisses = delta(after.llcMisses, before.llcMisses);
+        taskStats.counters.branchMisses = delta(after.branchMisses, before.branchMisses);
+        m_workers[workerId].counted = true;
+    }
+    taskDone(nodeId, batchId) = true;
+
+    for (const auto& outputField : m_graph.getNode(nodeId).getOutputs()) {
+        taskStats.bytesOut += ExecutorStats::bytesOf(m_graph.getMiniBatch(nodeId, batchId, outputField.first));
+    }
+    recordStats(workerId, nodeId, taskStats);
+    if (m_recording != nullptr) {
+        double startOffset = std::chrono::duration<double>(start - m_passStart).count();
+        m_workers[workerId].tasks.push_back(TaskRecord{nodeId, batchId, workerId, taskStats.elements,
+                                                       startOffset, taskStats.seconds});
+    }
+
+    updateDependencies(nodeId, batchId, workerId);
+}
+
+DAG_INLINE void Executor::executeQueuedTask(size_t nodeId, size_t batchId, size_t workerId) {
+    if (m_clusters.clusterOf.empty() || !m_clusters.isHead(nodeId)) {
+        executeTask(nodeId, batchId, workerId);
+        return;
+    }
+    // the other members only depend on the cluster, so the topological order keeps them ready
+    for (size_t member : m_clusters.members[m_clusters.clusterOf[nodeId]]) {
+        executeTask(member, batchId, workerId);
+    }
+}
+
+DAG_INLINE void Executor::recordStats(size_t workerId, size_t nodeId, const NodeStats& taskStats) {
+    m_workers[workerId].nodes[nodeId].add(taskStats);
+}
+
+DAG_INLINE void Executor::mergeWorkerStates() {
+    std::vector<TaskRecord> tasks;
+    for (const auto& worker : m_workers) {
+        for (size_t nodeId = 0; nodeId < worker.nodes.size(); ++nodeId) {
+            m_stats.nodes[nodeId].add(worker.nodes[nodeId]);
+        }
+        m_stats.hardwareCounters = m_stats.hardwareCounters || worker.counted;
+        for (const auto& edge : worker.edgeBytes) {
+            m_stats.edgeBytes[edge.first] += edge.second;
+        }
+        tasks.insert(tasks.end(), worker.tasks.begin(), worker.tasks.end());
+    }
+    if (m_recording != nullptr) {
+        std::stable_sort(tasks.begin(), tasks.end(), [](const TaskRecord& a, const TaskRecord& b) {
+            return a.start + a.seconds < b.start + b.seconds;
+        });
+        m_recording->tasks.insert(m_recording->tasks.end(), tasks.begin(), tasks.end());
+    }
+    m_workers.clear();
+}
+
+DAG_INLINE void Executor::executeNode(size_t nodeId, size_t batchId) {
+    const GraphNode& node = m_graph.getNode(nodeId);
+    if (node.hasColumnProcess()) {
+        // column process: the whole MiniBatches are handed over at once
+        std::map<std::string, const MiniBatch*> inputs;
+        std::map<std::string, MiniBatch*> outputs;
+        for (const auto& outputField : node.getOutputs()) {
+            acquireBuffer(nodeId, batchId, outputField.first);
+            outputs[outputField.first] = &m_graph.getMiniBatch(nodeId, batchId, outputField.first);
+        }
+        for (const auto& inputField : node.getInputs()) {
+            inputs[inputField.first] = &m_graph.getMiniBatch(nodeId, batchId, inputField.first);
+        }
+        node.executeColumns(inputs, outputs);
+    } else if (node.getComputeType() == ComputeType::CPU) {
+        // cpu process
+        // fields are passed in task-local maps, the same node may run for several batches at once
+        std::map<std::string, DataContainer> inputs;
+        std::map<std::string, DataContainer> outputs;
+        for (const auto& inputField : node.getInputs()) {
+            inputs[inputField.first] = DataContainer();
+        }
+        for (const auto& outputField : node.getOutputs()) {
+            outputs[outputField.first] = DataContainer();
+        }
+        for (const auto& outputField : node.getOutputs()) {
+            acquireBuffer(nodeId, batchId, outputField.first);
+        }
+        
+        // TODO: not solved yet for multiple inputs field, should cause problem
+        for (const auto& inputField : node.getInputs()) {
+            auto& inputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, inputField.first);
+
+            // an in-place output takes over the input storage and overwrites it element by element
+            const std::string* inPlaceOutput = findInPlaceOutput(nodeId, inputField.first);
+            if (inPlaceOutput != nullptr) {
+                auto& outputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, *inPlaceOutput);
+                outputMiniBatch.getData().swap(inputMiniBatch.getData());
+                outputMiniBatch.getValidity().swap(inputMiniBatch.getValidity());
+            }
+            auto& sourceMiniBatch = inPlaceOutput != nullptr
+                ? m_graph.getMiniBatch(nodeId, batchId, *inPlaceOutput) : inputMiniBatch;
+
+            // null elements make every output null without calling the node; the validity is read a
+            // word at a time, so words without nulls run every element and null words only add nulls
+            auto addNulls = [&](size_t count) {
+                for (const auto& outputField : outputs) {
+                    if (inPlaceOutput == nullptr || outputField.first != *inPlaceOutput) {
+                        m_graph.getMiniBatch(nodeId, batchId, outputField.first).addNulls(count);
+                    }
+                }
+            };
+            const size_t size = sourceMiniBatch.size();
+            for (size_t begin = 0; begin < size; begin += 64) {
+                size_t count = std::min<size_t>(64, size - begin);
+                uint64_t live = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+                const auto& validity = sourceMiniBatch.getValidity();
+                uint64_t valid = begin / 64 < validity.size() ? validity[begin / 64] & live : live;
+                if (valid == 0) {
+                    addNulls(count);
+                    continue;
+                }
+                for (size_t i = begin; i < begin + count; ++i) {
+                    if (valid != live && ((valid >> (i - begin)) & 1) == 0) {
+                        addNulls(1);
+                        continue;
+                    }
+                    inputs[inputField.first] = sourceMiniBatch.getData(i);
+                    node.execute(inputs, outputs);
+                    // Process each output MiniBatch
+                    for (auto& outputField : outputs) {
+                        if (inPlaceOutput != nullptr && outputField.first == *inPlaceOutput) {
+                            sourceMiniBatch.getData()[i] = std::move(outputField.second);
+                        } else {
+                            auto& outputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, outputField.first);
+                            outputMiniBatch.addData(outputField.second);
+                        }
+                        outputField.second = DataContainer();
+                    }
+                    inputs[inputField.first] = DataContainer();
+                }
+            }
+        }
+
+    } else {
+        // gpu process
+        #ifdef USE_CUDA
+        std::vector<MiniBatch> inputMiniBatches;
+        for (const auto& inputField : node.getInputs()) {
+            inputMiniBatches.push_back(m_graph.getMiniBatch(nodeId, batchId, inputField.first));
+        }
+
+        std::string outputName = node.getOutputs().begin()->first;
+        std::vector<MiniBatch> outputMiniBatches;
+        // cuda kernel
+        runCudaProcess(m_graph.getNode(nodeId), inputMiniBatches, outputMiniBatches, outputName);
+
+        // update output minibatch
+        for (const auto& outputMiniBatch : outputMiniBatches) {
+            acquireBuffer(nodeId, batchId, outputMiniBatch.getName());
+            m_graph.getMiniBatch(nodeId, batchId, outputMiniBatch.getName()) = outputMiniBatch;
+        }
+        #endif
+    }
+
+    // inputs are dead once the node has run
+    for (const auto& inputField : node.getInputs()) {
+        if (node.getOutputs().find(inputField.first) == node.getOutputs().end()) {
+            releaseBuffer(nodeId, batchId, inputField.first);
+        }
+    }
+}
+
+DAG_INLINE void Executor::updateDependencies(size_t nodeId, size_t batchId, size_t workerId) {
+    // Pass each connected output MiniBatch to the input port of the downstream node. Only connected
+    // fields move: their MiniBatches already exist, so no map is modified concurrently.
+    auto& edgeBytes = m_workers[workerId].edgeBytes;
+    const auto& connections = m_graph.getConnections(nodeId);
+    for (size_t i = 0; i < connections.size(); ++i) {
+        const PortEdge& port = connections[i];
+        auto& outputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, port.outPort);
+        acquireBuffer(port.to, batchId, port.inPort);
+        auto& inputMiniBatch = m_graph.getMiniBatch(port.to, batchId, port.inPort);
+
+        // the last reader of an output released after the copies takes its storage instead of a copy
+        bool lastReader = std::none_of(connections.begin() + i + 1, connections.end(),
+                                       [&port](const PortEdge& other) { return other.outPort == port.outPort; });
+        const BufferSlot* slot = findBufferSlot(nodeId, port.outPort);
+        size_t& copiedBytes = edgeBytes[{nodeId, port.to}];
+        if (lastReader && slot != nullptr && !slot->retained) {
+            inputMiniBatch.getData().swap(outputMiniBatch.getData());
+            inputMiniBatch.getValidity().swap(outputMiniBatch.getValidity());
+        } else {
+            inputMiniBatch.getData() = outputMiniBatch.getData();
+            inputMiniBatch.getValidity() = outputMiniBatch.getValidity();
+            copiedBytes += ExecutorStats::bytesOf(outputMiniBatch);
+        }
+    }
+
+    for (size_t downstreamNodeId : m_graph.getSuccessors(nodeId)) {
+        if (!m_inline) {
+            pendingPredecessors(downstreamNodeId, batchId).fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    // outputs are dead once passed to all successors, unless they are results
+    for (const auto& outputField : m_graph.getNode(nodeId).getOutputs()) {
+        releaseBuffer(nodeId, batchId, outputField.first);
+    }
+}
+
+DAG_INLINE const BufferSlot* Executor::findBufferSlot(size_t nodeId, const std::string& fieldName) const {
+    const auto& slots = m_graph.getBufferAssignment().slots;
+    if (nodeId >= slots.size()) {
+        return nullptr;
+    }
+    auto it = slots[nodeId].find(fieldName);
+    return it == slots[nodeId].end() ? nullptr : &it->second;
+}
+
+DAG_INLINE const std::string* Executor::findInPlaceOutput(size_t nodeId, const std::string& inputName) const {
+    const GraphNode& node = m_graph.getNode(nodeId);
+    auto it = node.getInPlacePorts().find(inputName);
+    // with several inputs, the outputs receive the elements of every input in turn
+    if (node.getInputs().size() != 1 || it == node.getInPlacePorts().end() || node.getOutputs().find(it->second) == node.getOutputs().end()
+        || node.getOutputs().find(inputName) != node.getOutputs().end()) {
+        return nullptr;
+    }
+    const BufferSlot* slot = findBufferSlot(nodeId, inputName);
+    if (slot == nullptr || slot->retained) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+DAG_INLINE void Executor::acquireBuffer(size_t nodeId, size_t batchId, const std::string& fieldName) {
+    const BufferSlot* slot = findBufferSlot(nodeId, fieldName);
+    if (slot == nullptr) {
+        return;
+    }
+    MiniBatch& miniBatch = m_graph.getMiniBatch(nodeId, batchId, fieldName);
+    auto& data = miniBatch.getData();
+    {
+        std::unique_lock<std::mutex> lock = lockUnlessInline(m_bufferMutex);
+        auto& storage = m_bufferPool[slot->buffer];
+        if (storage.capacity() > data.capacity()) {
+            data.swap(storage);
+        }
+    }
+    miniBatch.clear();
+}
+
+DAG_INLINE void Executor::releaseBuffer(size_t nodeId, size_t batchId, const std::string& fieldName) {
+    const BufferSlot* slot = findBufferSlot(nodeId, fieldName);
+    if (slot == nullptr || slot->retained) {
+        return;
+    }
+    MiniBatch& miniBatch = m_graph.getMiniBatch(nodeId, batchId, fieldName);
+    MiniBatchData released;
+    released.swap(miniBatch.getData());
+    miniBatch.getValidity().clear();
+    released.clear();
+    std::unique_lock<std::mutex> lock = lockUnlessInline(m_bufferMutex);
+    auto& storage = m_bufferPool[slot->buffer];
+    if (released.capacity() > storage.capacity()) {
+        storage.swap(released);
+    }
+}
@@ -1,190 +1,502 @@
-// Copyright (C) 2024 Haochen Jiang
-//
-// Authors: Haochen Jiang
-// Date: 2024/1/2
-
-/**
- * @file executor.h
- *
- * @brief Manages the execution of nodes within a graph in parallel.
- *
- * This file contains the Executor class which takes a Graph object and a collection of input MiniBatches.
- * It manages the parallel execution of GraphNodes within the Graph, utilizing a thread pool approach.
- * Each node in the Graph is processed in a separate thread, respecting the dependency order.
- */
-
-#pragma once
-
-#include <thread>
-#include <vector>
-#include <functional>
-#include <unordered_map>
-#include "graph.h"
-#include "queue.h"
-
-#ifdef USE_CUDA
-    #include "cuda_kernel.cu"
-#endif
-
-class Executor {
-public:
-    /**
-     * @brief Constructs an Executor with a reference to a Graph and a set of input MiniBatches.
-     * 
-     * @param graph Reference to the Graph object to be executed.
-     * @param inputBatches A vector of unordered maps, each map containing string-to-MiniBatch
-     *                     pairs representing input data for each node of the graph.
-     */
-    Executor(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches)
-        : m_graph(graph), m_inputBatches(inputBatches) {
-        initialize();
-    }
-
-    /**
-     * @brief Starts the execution process of the graph.
-     * 
-     * Initializes a task queue and creates worker threads equal to the number of hardware threads available.
-     * Each worker thread processes nodes from the task queue.
-     */
-    void run() {
-        initializeTaskQueue();
-        std::vector<std::thread> workers;
-        for (size_t i = 0; i < std::thread::hardware_concurrency(); ++i) {
-            workers.emplace_back(&Executor::workerThread, this);
-        }
-
-        for (auto& worker : workers) {
-            worker.join();
-        }
-    }
-
-private:
-    Graph& m_graph;
-    const std::vector<std::unordered_map<std::string, MiniBatch>>& m_inputBatches;
-    ThreadSafeQueue<std::pair<size_t, size_t>> m_taskQueue; // Pair of nodeId and batchId
-
-    /**
-     * @brief Initializes MiniBatches in the Graph and sets up input data for root nodes.
-     */
-    void initialize() {
-        std::cout << "Initialize MiniBatches in Graph" << std::endl;
-        m_graph.initMiniBatches(m_inputBatches.size());
-
-        std::cout << "Filling input MiniBatches for root nodes" << std::endl;
-        for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
-            const auto& batchMap = m_inputBatches[batchId];
-            for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
-                if (m_graph.isRoot(nodeId)) {
-                    auto& nodeBatches = m_graph.getNodeMiniBatches(nodeId);
-                    for (const auto& inputField : batchMap) {
-                        nodeBatches[batchId][inputField.first] = inputField.second;
-                    }
-                }
-            }
-        }
-    }
-
-    /**
-     * @brief Initializes the task queue with all nodes and their respective batch IDs.
-     */
-    void initializeTaskQueue() {
-        for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
-            for (size_t batchId = 0; batchId < m_inputBatches.size(); ++batchId) {
-                m_taskQueue.push({nodeId, batchId});
-            }
-        }
-    }
-
-    /**
-     * @brief Worker thread function to process tasks from the task queue.
-     */
-    void workerThread() {
-        std::pair<size_t, size_t> task;
-        while (m_taskQueue.try_pop(task)) {
-            size_t nodeId = task.first;
-            size_t batchId = task.second;
-
-            if (!m_graph.isReady(nodeId, batchId)) {
-                m_taskQueue.push(task); // Task not ready, requeue it
-                continue;
-            }
-
-            executeNode(nodeId, batchId);
-            updateDependencies(nodeId, batchId);
-        }
-    }
-
-    /**
-     * @brief Executes a single node for a specific batch.
-     * 
-     * @param nodeId The ID of the node to be executed.
-     * @param batchId The ID of the batch being processed.
-     */
-    void executeNode(size_t nodeId, size_t batchId) {
-        GraphNode& node = m_graph.getNode(nodeId);
-        // cpu process
-        if (node.getComputeType() == ComputeType::CPU) {
-            // Iterate over each input field and corresponding MiniBatch
-            size_t batchSize = m_graph.getMiniBatch(nodeId, batchId, node.getInputs().begin()->first).size();
-            std::cout << "batchSize: " << batchSize << std::endl;
-            
-            // TODO: not solved yet for multiple inputs field, should cause problem
-            for (const auto& inputField : node.getInputs()) {
-                auto& inputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, inputField.first);
-
-                for (size_t i = 0; i < inputMiniBatch.size(); ++i) {
-                    node.setInput(inputField.first, inputMiniBatch.getData(i));
-                    node.execute();
-                    // Process each output MiniBatch
-                    for (const auto& outputField : node.getOutputs()) {
-                        auto& outputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, outputField.first);
-                        outputMiniBatch.addData(node.getOutput(outputField.first));
-                    }
-                    node.cleanUp();
-                }
-            }
-
-        } else {
-            // gpu process
-            #ifdef USE_CUDA
-            std::vector<MiniBatch> inputMiniBatches;
-            for (const auto& inputField : node.getInputs()) {
-                inputMiniBatches.push_back(m_graph.getMiniBatch(nodeId, batchId, inputField.first));
-            }
-
-            std::string outputName = node.getOutputs().begin()->first;
-            std::vector<MiniBatch> outputMiniBatches;
-            // cuda kernel
-            runCudaProcess(node, inputMiniBatches, outputMiniBatches, outputName);
-
-            node.setOutputBatch(outputMiniBatches);
-            // update output minibatch
-            for (const auto& outputField : node.getOutputs()) {
-                auto& outputMiniBatch = node.getOutputBatch(outputField.first);
-                m_graph.getMiniBatch(nodeId, batchId, outputField.first) = outputMiniBatch;
-            }
-            #endif
-        }
-
-    }
-
-    /**
-     * @brief Updates dependencies for downstream nodes after a node's execution.
-     * 
-     * @param nodeId The ID of the node that has just been executed.
-     * @param batchId The ID of the batch that was processed.
-     */
-    void updateDependencies(size_t nodeId, size_t batchId) {
-        // Update the dependencies for downstream nodes
-        for (size_t downstreamNodeId = 0; downstreamNodeId < m_graph.size(); ++downstreamNodeId) {
-            if (m_graph.edgeExists(nodeId, downstreamNodeId)) {
-                // Copy each output MiniBatch to corresponding input MiniBatch of downstream node
-                for (const auto& outputField : m_graph.getNode(nodeId).getOutputs()) {
-                    auto& outputMiniBatch = m_graph.getMiniBatch(nodeId, batchId, outputField.first);
-                    auto& inputMiniBatch = m_graph.getMiniBatch(downstreamNodeId, batchId, outputField.first);
-                    inputMiniBatch = outputMiniBatch;
-                }
-            }
-        }
-    }
-};
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/1/2
+
+/**
+ * @file executor.h
+ *
+ * @brief Manages the execution of nodes within a graph in parallel.
+ *
+ * This file contains the Executor class which takes a Graph object and a collection of input MiniBatches.
+ * It manages the parallel execution of GraphNodes within the Graph, utilizing a thread pool approach.
+ * Each node in the Graph is processed in a separate thread, respecting the dependency order.
+ */
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include "dag_config.h"
+#include "concurrency.h"
+#include "graph.h"
+#include "queue.h"
+#include "executor_stats.h"
+#include "recording.h"
+#include "task_group.h"
+
+#ifdef USE_CUDA
+    #include "cuda_kernel.h"
+#endif
+
+/**
+ * @brief How run() executes the tasks.
+ */
+enum class ExecutionMode {
+    Auto, ///< Inline below the inline threshold, parallel otherwise.
+    Inline, ///< On the calling thread, in topological order, without any synchronization.
+    Parallel ///< On a pool of worker threads.
+};
+
+class Executor {
+public:
+    /**
+     * @brief Constructs an Executor with a reference to a Graph and a set of input MiniBatches.
+     * 
+     * @param graph Reference to the Graph object to be executed.
+     * @param inputBatches A vector of unordered maps, each map containing string-to-MiniBatch
+     *                     pairs representing input data for each node of the graph.
+     */
+    Executor(Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches)
+        : m_graph(graph), m_inputBatches(inputBatches) {
+        initialize();
+    }
+
+    /**
+     * @brief Starts the execution process of the graph.
+     * 
+     * Initializes a task queue and creates worker threads, one per CPU available to the process by default.
+     * Each worker thread processes nodes from the task queue. Small graphs are executed inline instead,
+     * see setExecutionMode(). Tasks already run by evaluate() are skipped.
+     */
+    void run();
+
+    /**
+     * @brief Computes a single output field, running only the nodes it depends on.
+     *
+     * The ancestors of the node that haven't run yet for the batch are executed like run() does, so
+     * independent ancestors run in parallel. Every task runs at most once: results are kept for later
+     * calls to evaluate() and run(), which only execute the remaining tasks.
+     *
+     * @param nodeId The ID of the node.
+     * @param field The name of an output field of the node.
+     * @param batchId The ID of the batch.
+     * @return The output MiniBatch.
+     * @throws std::invalid_argument If the field is not an output of the node.
+     * @throws std::logic_error If buffer reuse releases the field once it is consumed.
+     */
+    const MiniBatch& evaluate(size_t nodeId, const std::string& field, size_t batchId);
+
+    /**
+     * @brief Prepares the executor to run the whole graph again, without setting it up anew.
+     *
+     * Every task is marked as not run, the outputs are emptied and the root nodes receive the current
+     * content of the input batches, which the caller may have changed in place since the executor was
+     * created. The graph stays compiled and the MiniBatches keep their storage, so iterating over
+     * reset() and run() allocates nothing once the sizes are stable.
+     *
+     * @param validateTypes False to skip scanning the elements of the inputs against the declared
+     *                      types, when the caller knows they kept their types, e.g. because they were
+     *                      refilled from outputs of the same types. Missing fields are always reported.
+     * @throws std::logic_error If the number of input batches changed.
+     * @throws std::invalid_argument If an input batch misses a field or holds an element of another type.
+     */
+    void reset(bool validateTypes = true);
+
+    /**
+     * @brief Sets how run() executes the tasks.
+     *
+     * @param mode The execution mode, ExecutionMode::Auto by default.
+     */
+    void setExecutionMode(ExecutionMode mode) {
+        m_executionMode = mode;
+    }
+
+    /**
+     * @brief Sets the amount of work below which ExecutionMode::Auto executes inline.
+     *
+     * @param work Threshold on the number of nodes times the total number of input elements.
+     */
+    void setInlineThreshold(size_t work) {
+        m_inlineThreshold = work;
+    }
+
+    /**
+     * @brief Checks if run() executes the tasks inline on the calling thread.
+     *
+     * @return True if the graph is executed inline, false if it is executed by worker threads.
+     */
+    bool runsInline() const;
+
+    /**
+     * @brief Sets the number of worker threads used by run().
+     *
+     * @param numThreads The number of worker threads, 0 for defaultWorkerCount(): one per CPU the
+     *                   affinity mask and the cgroup quota allow, or DAG_NUM_THREADS if set.
+     */
+    void setNumThreads(size_t numThreads) {
+        m_numThreads = numThreads;
+    }
+
+    /**
+     * @brief Gets the number of worker threads used by run().
+     *
+     * @return The number of worker threads.
+     */
+    size_t getNumThreads() const {
+        if (m_numThreads != 0) {
+            return m_numThreads;
+        }
+        return defaultWorkerCount();
+    }
+
+    /**
+     * @brief Sets how much of the next task's input data a worker prefetches while running a task.
+     *
+     * Each worker looks one ready task ahead in the task queue and issues software prefetches for the
+     * storage of its input MiniBatches, so that it runs on warm caches. Only the DataContainer slots are
+     * prefetched, not the heap storage of strings and vectors.
+     *
+     * @param bytes Maximum number of bytes prefetched per task, 0 to disable the lookahead.
+     */
+    void setPrefetchLimit(size_t bytes) {
+        m_prefetchLimit = bytes;
+    }
+
+    /**
+     * @brief Attributes hardware performance counters to every task.
+     *
+     * Each worker opens a perf_event_open session for its own thread and reads it around every task,
+     * so NodeStats gets the cycles, instructions, last level cache misses and branch misses of each
+     * node. If the counters are unavailable the run proceeds without them and
+     * ExecutorStats::hardwareCounters stays false.
+     *
+     * @param enable True to read the counters, false by default.
+     */
+    void setHardwareCounters(bool enable) {
+        m_hardwareCounters = enable;
+    }
+
+    /**
+     * @brief Runs connected groups of cheap nodes as single tasks, see Graph::coarsen().
+     *
+     * At the start of each parallel run, nodes are clustered by their expected cost per task: the
+     * average measured by earlier runs of this executor, or GraphNode::getCostEstimate() before the
+     * first one. Nodes of unknown cost are not clustered. A cluster is queued once per batch and its
+     * nodes run back to back on one worker, saving the queue operations and dependency updates
+     * between them. Inline runs and evaluate() are not coarsened.
+     *
+     * @param grainSeconds Largest expected duration of a cluster task, 0 to disable (the default).
+     */
+    void setCoarsening(double grainSeconds) {
+        m_grainSeconds = grainSeconds;
+    }
+
+    /**
+     * @brief Sets the order in which run() submits the tasks.
+     *
+     * Tasks are still executed only once their inputs are ready, so the schedule is a priority order:
+     * e.g. the recorded order of a previous run, or the order planned by Graph::planMemory().
+     *
+     * @param schedule Every (nodeId, batchId) task exactly once, or an empty vector for the default order.
+     * @throws std::invalid_argument If a task is out of range, repeated or missing.
+     */
+    void setSchedule(const std::vector<ScheduleStep>& schedule);
+
+    /**
+     * @brief Records the graph, its inputs and the timing of every task during the next runs.
+     *
+     * The definition is captured by the first run() or evaluate() after construction or reset(), and
+     * the tasks of every later call are appended, so a recording set before evaluate() and run() holds
+     * every task once.
+     *
+     * @param recording The recording to fill, or nullptr to stop recording. It must outlive the runs.
+     */
+    void setRecording(Recording* recording) {
+        m_recording = recording;
+    }
+
+    /**
+     * @brief Retrieves the statistics collected by run().
+     *
+     * @return The per-node and per-edge statistics.
+     */
+    const ExecutorStats& getStats() const {
+        return m_stats;
+    }
+
+private:
+    /**
+     * @brief State of a (batchId, nodeId) task, alone on its cache line so that neighbouring tasks don't
+     *        share lines.
+     */
+    struct alignas(DAG_CACHE_LINE_SIZE) TaskState {
+        std::atomic<size_t> pendingPredecessors; ///< Predecessors left to run in the current run.
+        bool done; ///< Whether the task has run, in this run or an earlier one.
+    };
+
+    /**
+     * @brief State written by a single worker during a run, merged into m_stats once the workers joined.
+     *
+     * Blocks are cache-line aligned and the statistics are allocated by BufferAllocator, whose buffers
+     * don't share cache lines either, so workers never write to the same line.
+     */
+    struct alignas(DAG_CACHE_LINE_SIZE) WorkerState {
+        std::vector<NodeStats, BufferAllocator<NodeStats>> nodes; ///< Statistics of each node.
+        std::map<std::pair<size_t, size_t>, size_t> edgeBytes; ///< Bytes copied along each edge.
+        std::vector<TaskRecord> tasks; ///< Recorded tasks, in completion order.
+        PerfCounters* counters = nullptr; ///< Hardware counters of the worker's thread, if enabled and available.
+        bool counted = false; ///< Whether the counters were read for a task.
+    };
+
+    Graph& m_graph;
+    const std::vector<std::unordered_map<std::string, MiniBatch>>& m_inputBatches;
+    ThreadSafeQueue<std::pair<size_t, size_t>> m_taskQueue; // Pair of nodeId and batchId
+    std::vector<MiniBatchData> m_bufferPool; // Released storage of each physical buffer
+    alignas(DAG_CACHE_LINE_SIZE) std::mutex m_bufferMutex; // Protects m_bufferPool
+    ExecutorStats m_stats; // Statistics of the runs, aggregated from m_workers
+    std::vector<WorkerState> m_workers; // Per-worker state of the current run
+    std::vector<ScheduleStep> m_schedule; // Submission order of the tasks, empty for the default order
+    Recording* m_recording = nullptr; // Recording filled by run() and evaluate(), if any
+    std::chrono::steady_clock::time_point m_runStart; // Start of the current run
+    std::chrono::steady_clock::time_point m_passStart; // Start of the first run() or evaluate() since the last reset
+    size_t m_numThreads = 0; // Number of worker threads, 0 for defaultWorkerCount()
+    std::unique_ptr<TaskState[]> m_taskStates; // State of each (batchId, nodeId) task
+    size_t m_numTasks = 0; // Number of entries of m_taskStates
+    ExecutionMode m_executionMode = ExecutionMode::Auto; // How run() executes the tasks
+    size_t m_inlineThreshold = 4096; // Work below which ExecutionMode::Auto executes inline
+    bool m_inline = false; // Whether the current run executes inline, without locking
+    size_t m_prefetchLimit = 256 * 1024; // Bytes of the next task's inputs prefetched, 0 to disable
+    bool m_hardwareCounters = false; // Whether tasks are measured with hardware counters
+    double m_grainSeconds = 0.0; // Largest expected duration of a coarsened cluster, 0 to disable
+    TaskClusters m_clusters; // Clusters of the current run, empty if it isn't coarsened
+    TaskPool m_taskPool; // Child tasks spawned by the node bodies through TaskGroup
+    alignas(DAG_CACHE_LINE_SIZE) std::atomic<size_t> m_remainingTasks{0}; // Queued tasks not completed yet
+
+    /**
+     * @brief Seconds elapsed since a time point.
+     */
+    static double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * @brief Initializes MiniBatches in the Graph and sets up input data for root nodes.
+     */
+    void initialize();
+
+    /**
+     * @brief Copies the input batches into the input MiniBatches of the root nodes.
+     */
+    void fillRootInputs();
+
+    /**
+     * @brief Checks that the input batches provide every required input of the root nodes, with the
+     *        declared types.
+     *
+     * @param checkTypes False to only check that the fields are present.
+     * @throws std::invalid_argument If an input is missing or holds an element of another type.
+     */
+    void validateInputBatches(bool checkTypes = true) const;
+
+    /**
+     * @brief Executes a set of tasks, in parallel or inline, and collects their statistics.
+     *
+     * @param tasks The tasks in submission order, including every predecessor that hasn't run yet.
+     * @param coarsen Whether a parallel execution runs clusters of cheap nodes as single tasks.
+     */
+    void executeTasks(const std::vector<ScheduleStep>& tasks, bool coarsen);
+
+    /**
+     * @brief Largest page size backing the MiniBatches of the graph and the buffer pool.
+     */
+    size_t largestPageSize();
+
+    /**
+     * @brief Expected seconds per task of each node, infinite if unknown.
+     */
+    std::vector<double> taskCosts() const;
+
+    /**
+     * @brief Initializes the readiness counters of a set of tasks and fills the task queue with them.
+     *
+     * Members of a cluster are queued only if its head has already run, otherwise the head's task
+     * runs them.
+     *
+     * @param tasks The tasks in submission order.
+     */
+    void initializeTaskQueue(const std::vector<ScheduleStep>& tasks);
+
+    /**
+     * @brief Worker thread function to process tasks from the task queue.
+     *
+     * @param workerId Index of the worker thread.
+     */
+    void workerThread(size_t workerId);
+
+    /**
+     * @brief Processes tasks from the task queue until it is empty, then child tasks until every
+     *        task of the run has completed.
+     *
+     * @param workerId Index of the worker thread.
+     */
+    void processQueue(size_t workerId);
+
+    /**
+     * @brief Checks if every predecessor of a task has run.
+     */
+    bool isReady(const std::pair<size_t, size_t>& task) {
+        return pendingPredecessors(task.first, task.second).load(std::memory_order_acquire) == 0;
+    }
+
+    /**
+     * @brief Prefetches the input MiniBatches of a ready task into the cache, up to the prefetch limit.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch.
+     */
+    void prefetchInputs(size_t nodeId, size_t batchId);
+
+    /**
+     * @brief Orders tasks so that each one comes after its predecessors, keeping the given order
+     *        wherever the dependencies allow it.
+     *
+     * @param tasks The tasks in priority order, including every predecessor that hasn't run yet.
+     * @return The earliest ready task first, then the next one, until every task is taken.
+     */
+    std::vector<ScheduleStep> readyOrder(const std::vector<ScheduleStep>& tasks);
+
+    /**
+     * @brief Starts timing a call to run() or evaluate().
+     *
+     * The first call since construction or reset() starts a pass: it captures the recording, if any,
+     * and sets the origin of the recorded start times, so that the tasks of later calls are appended.
+     */
+    void beginCall();
+
+    /**
+     * @brief Executes a set of tasks on the calling thread.
+     *
+     * The tasks come in the compiled topological order of each batch, or in the schedule set by
+     * setSchedule() as ordered by readyOrder(), so every task is ready when reached and no queue,
+     * counter or lock is needed.
+     *
+     * @param tasks The tasks in execution order.
+     */
+    void runInline(const std::vector<ScheduleStep>& tasks);
+
+    /**
+     * @brief Executes a ready task, records its statistics and feeds its successors.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch.
+     * @param workerId Index of the worker thread executing the task.
+     */
+    void executeTask(size_t nodeId, size_t batchId, size_t workerId);
+
+    /**
+     * @brief Executes a ready task popped from the task queue, with the rest of its cluster if the
+     *        node heads one.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch.
+     * @param workerId Index of the worker thread executing the task.
+     */
+    void executeQueuedTask(size_t nodeId, size_t batchId, size_t workerId);
+
+    /**
+     * @brief Locks a mutex, unless the current run executes inline.
+     *
+     * @param mutex The mutex to lock.
+     * @return A lock owning the mutex, or owning nothing when inline.
+     */
+    std::unique_lock<std::mutex> lockUnlessInline(std::mutex& mutex) {
+        return m_inline ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(mutex);
+    }
+
+    /**
+     * @brief Number of predecessors of a node that have not run yet for a batch.
+     */
+    std::atomic<size_t>& pendingPredecessors(size_t nodeId, size_t batchId) {
+        return m_taskStates[batchId * m_graph.size() + nodeId].pendingPredecessors;
+    }
+
+    /**
+     * @brief Whether a task has run, in this run or an earlier one.
+     */
+    bool& taskDone(size_t nodeId, size_t batchId) {
+        return m_taskStates[batchId * m_graph.size() + nodeId].done;
+    }
+
+    /**
+     * @brief Accumulates the statistics of one task into the node statistics of its worker.
+     *
+     * @param workerId Index of the worker thread that executed the task.
+     * @param nodeId The ID of the node that has just been executed.
+     * @param taskStats The statistics of the task.
+     */
+    void recordStats(size_t workerId, size_t nodeId, const NodeStats& taskStats);
+
+    /**
+     * @brief Merges the state of every worker into the statistics and the recording.
+     */
+    void mergeWorkerStates();
+
+    /**
+     * @brief Executes a single node for a specific batch.
+     * 
+     * @param nodeId The ID of the node to be executed.
+     * @param batchId The ID of the batch being processed.
+     */
+    void executeNode(size_t nodeId, size_t batchId);
+
+    /**
+     * @brief Updates dependencies for downstream nodes after a node's execution.
+     * 
+     * @param nodeId The ID of the node that has just been executed.
+     * @param batchId The ID of the batch that was processed.
+     * @param workerId Index of the worker thread that executed the node.
+     */
+    void updateDependencies(size_t nodeId, size_t batchId, size_t workerId);
+
+    /**
+     * @brief Looks up the physical buffer assigned to a MiniBatch.
+     *
+     * @param nodeId The ID of the node.
+     * @param fieldName The name of the field.
+     * @return The buffer slot, or nullptr if the MiniBatch doesn't share a buffer.
+     */
+    const BufferSlot* findBufferSlot(size_t nodeId, const std::string& fieldName) const;
+
+    /**
+     * @brief Finds the output a node may write in place over one of its inputs.
+     *
+     * The input storage is reused only if the node declared the mapping and liveness analysis shows
+     * the input MiniBatch dies at this node, i.e. the node is its last reader.
+     *
+     * @param nodeId The ID of the node.
+     * @param inputName The name of the input field.
+     * @return The name of the in-place output, or nullptr if the input must be kept.
+     */
+    const std::string* findInPlaceOutput(size_t nodeId, const std::string& inputName) const;
+
+    /**
+     * @brief Hands the storage released to a MiniBatch's buffer over to the MiniBatch before it is written.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch.
+     * @param fieldName The name of the field.
+     */
+    void acquireBuffer(size_t nodeId, size_t batchId, const std::string& fieldName);
+
+    /**
+     * @brief Hands the storage of a dead MiniBatch back to its buffer, leaving the MiniBatch empty.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch.
+     * @param fieldName The name of the field.
+     */
+    void releaseBuffer(size_t nodeId, size_t batchId, const std::string& fieldName);
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "executor.cpp"
+#endif
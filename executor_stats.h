@@ -0,0 +1,114 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/3/25
+
+/**
+ * @file executor_stats.h
+ *
+ * @brief Runtime statistics collected by the Executor.
+ *
+ * ExecutorStats accumulates, for every node of the graph, the time spent executing it and the amount
+ * of data it read and wrote, as well as the number of bytes copied along every edge. Optionally, hardware
+ * counters tell whether a node is compute- or memory-bound.
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <utility>
+#include "mini_batch.h"
+#include "perf_counters.h"
+
+/**
+ * @brief Statistics of a single node, accumulated over all batches.
+ */
+struct NodeStats {
+    size_t invocations = 0; ///< Number of (node, batch) tasks executed.
+    double seconds = 0.0; ///< Total wall-clock time spent executing the node.
+    size_t elements = 0; ///< Number of input elements processed.
+    size_t bytesIn = 0; ///< Bytes of the input MiniBatches read.
+    size_t bytesOut = 0; ///< Bytes of the output MiniBatches written.
+    size_t countedElements = 0; ///< Input elements of the tasks measured by hardware counters.
+    CounterValues counters; ///< Hardware counters of the measured tasks, see Executor::setHardwareCounters().
+
+    /**
+     * @brief Accumulates the statistics of other tasks of the node.
+     *
+     * @param other The statistics to add.
+     */
+    void add(const NodeStats& other) {
+        invocations += other.invocations;
+        seconds += other.seconds;
+        elements += other.elements;
+        bytesIn += other.bytesIn;
+        bytesOut += other.bytesOut;
+        countedElements += other.countedElements;
+        counters.cycles += other.counters.cycles;
+        counters.instructions += other.counters.instructions;
+        counters.llcMisses += other.counters.llcMisses;
+        counters.branchMisses += other.counters.branchMisses;
+    }
+
+    /**
+     * @brief Throughput of the node.
+     *
+     * @return Input elements processed per second, 0 if the node never ran.
+     */
+    double elementsPerSecond() const {
+        return seconds > 0.0 ? elements / seconds : 0.0;
+    }
+
+    /**
+     * @brief Instructions retired per cycle: low values point at a memory-bound node.
+     *
+     * @return The IPC of the measured tasks, 0 if none was measured.
+     */
+    double instructionsPerCycle() const {
+        return counters.cycles > 0 ? static_cast<double>(counters.instructions) / counters.cycles : 0.0;
+    }
+
+    /**
+     * @brief Last level cache misses per input element of the measured tasks.
+     *
+     * @return The misses per element, 0 if no element was measured.
+     */
+    double llcMissesPerElement() const {
+        return countedElements > 0 ? static_cast<double>(counters.llcMisses) / countedElements : 0.0;
+    }
+
+    /**
+     * @brief Branch misses per input element of the measured tasks.
+     *
+     * @return The misses per element, 0 if no element was measured.
+     */
+    double branchMissesPerElement() const {
+        return countedElements > 0 ? static_cast<double>(counters.branchMisses) / countedElements : 0.0;
+    }
+};
+
+/**
+ * @brief Statistics of a whole graph execution.
+ */
+struct ExecutorStats {
+    std::vector<NodeStats> nodes; ///< Statistics of each node, indexed by node ID.
+    std::map<std::pair<size_t, size_t>, size_t> edgeBytes; ///< Bytes copied along each (from, to) edge.
+    double wallSeconds = 0.0; ///< Wall-clock time of the whole run.
+    size_t pageSize = 0; ///< Largest page size backing the executor's MiniBatch buffers, see BufferPages::pageSize(const void*).
+    bool hardwareCounters = false; ///< Whether hardware counters were read for any task.
+    size_t scheduledTasks = 0; ///< Tasks submitted to the task queue, a coarsened cluster counting once.
+
+    /**
+     * @brief Approximate number of bytes held by a MiniBatch.
+     *
+     * Only the DataContainer slots and the validity bitmap are counted, not the heap storage of strings
+     * and vectors.
+     *
+     * @param batch The MiniBatch to measure.
+     * @return The size of the MiniBatch in bytes.
+     */
+    static size_t bytesOf(const MiniBatch& batch) {
+        return batch.size() * sizeof(DataContainer) + batch.getValidity().size() * sizeof(uint64_t);
+    }
+};
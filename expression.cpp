@@ -0,0 +1,844 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/27
+
+/**
+ * @file expression.cpp
+ *
+ * @brief Implements the parsing, folding, compilation and evaluation of expressions.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by expression.h otherwise.
+ */
+
+#include "expression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace expression_detail {
+
+using Op = Expression::Op;
+using Node = Expression::Node;
+using NodePtr = std::shared_ptr<const Node>;
+
+struct Function {
+    const char* name;
+    Op op;
+    size_t arity;
+};
+
+static const Function functions[] = {
+    {"sqrt", Op::Sqrt, 1}, {"abs", Op::Abs, 1}, {"exp", Op::Exp, 1}, {"log", Op::Log, 1},
+    {"sin", Op::Sin, 1}, {"cos", Op::Cos, 1}, {"floor", Op::Floor, 1}, {"ceil", Op::Ceil, 1},
+    {"pow", Op::Pow, 2}, {"min", Op::Min, 2}, {"max", Op::Max, 2}
+};
+
+DAG_INLINE NodePtr makeConstant(double value) {
+    auto node = std::make_shared<Node>();
+    node->op = Op::Constant;
+    node->value = value;
+    return node;
+}
+
+DAG_INLINE NodePtr makeColumn(const std::string& name) {
+    auto node = std::make_shared<Node>();
+    node->op = Op::Column;
+    node->column = name;
+    return node;
+}
+
+DAG_INLINE NodePtr makeOp(Op op, std::vector<NodePtr> args) {
+    auto node = std::make_shared<Node>();
+    node->op = op;
+    node->args = std::move(args);
+    return node;
+}
+
+/**
+ * @brief Compares two doubles by bit pattern, so that -0 differs from 0 and a nan equals itself.
+ */
+DAG_INLINE bool sameBits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+DAG_INLINE bool isConstant(const NodePtr& node, double value) {
+    return node->op == Op::Constant && sameBits(node->value, value);
+}
+
+/**
+ * @brief Recursive descent parser, one function per precedence level.
+ */
+class Parser {
+public:
+    explicit Parser(const std::string& text) : text(text) {}
+
+    NodePtr parse() {
+        NodePtr root = parseSelect();
+        skipSpaces();
+        if (pos != text.size()) {
+            fail("unexpected '" + std::string(1, text[pos]) + "'");
+        }
+        return root;
+    }
+
+private:
+    const std::string& text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::invalid_argument("Invalid expression at position " + std::to_string(pos) + ": " + message + ".");
+    }
+
+    void skipSpaces() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    bool accept(const char* token) {
+        skipSpaces();
+        size_t length = std::char_traits<char>::length(token);
+        if (text.compare(pos, length, token) != 0) {
+            return false;
+        }
+        // "<" must not consume the first character of "<=", nor "!" the one of "!="
+        if (length == 1 && pos + 1 < text.size() && text[pos + 1] == '=' && std::string("<>!=").find(token[0]) != std::string::npos) {
+            return false;
+        }
+        pos += length;
+        return true;
+    }
+
+    void expect(const char* token) {
+        if (!accept(token)) {
+            fail("expected '" + std::string(token) + "'");
+        }
+    }
+
+    NodePtr parseSelect() {
+        NodePtr condition = parseOr();
+        if (!accept("?")) {
+            return condition;
+        }
+        NodePtr ifTrue = parseSelect();
+        expect(":");
+        NodePtr ifFalse = parseSelect();
+        return makeOp(Op::Select, {condition, ifTrue, ifFalse});
+    }
+
+    NodePtr parseOr() {
+        NodePtr left = parseAnd();
+        while (accept("||")) {
+            left = makeOp(Op::Or, {left, parseAnd()});
+        }
+        return left;
+    }
+
+    NodePtr parseAnd() {
+        NodePtr left = parseEquality();
+        while (accept("&&")) {
+            left = makeOp(Op::And, {left, parseEquality()});
+        }
+        return left;
+    }
+
+    NodePtr parseEquality() {
+        NodePtr left = parseComparison();
+        while (true) {
+            if (accept("==")) {
+                left = makeOp(Op::Eq, {left, parseComparison()});
+            } else if (accept("!=")) {
+                left = makeOp(Op::Ne, {left, parseComparison()});
+            } else {
+                return left;
+            }
+        }
+    }
+
+    NodePtr parseComparison() {
+        NodePtr left = parseSum();
+        while (true) {
+            if (accept("<=")) {
+                left = makeOp(Op::Le, {left, parseSum()});
+            } else if (accept(">=")) {
+                left = makeOp(Op::Ge, {left, parseSum()});
+            } else if (accept("<")) {
+                left = makeOp(Op::Lt, {left, parseSum()});
+            } else if (accept(">")) {
+                left = makeOp(Op::Gt, {left, parseSum()});
+            } else {
+                return left;
+            }
+        }
+    }
+
+    NodePtr parseSum() {
+        NodePtr left = parseProduct();
+        while (true) {
+            if (accept("+")) {
+                left = makeOp(Op::Add, {left, parseProduct()});
+            } else if (accept("-")) {
+                left = makeOp(Op::Sub, {left, parseProduct()});
+            } else {
+                return left;
+            }
+        }
+    }
+
+    NodePtr parseProduct() {
+        NodePtr left = parseUnary();
+        while (true) {
+            if (accept("*")) {
+                left = makeOp(Op::Mul, {left, parseUnary()});
+            } else if (accept("/")) {
+                left = makeOp(Op::Div, {left, parseUnary()});
+            } else if (accept("%")) {
+                left = makeOp(Op::Mod, {left, parseUnary()});
+            } else {
+                return left;
+            }
+        }
+    }
+
+    NodePtr parseUnary() {
+        if (accept("-")) {
+            return makeOp(Op::Neg, {parseUnary()});
+        }
+        if (accept("!")) {
+            return makeOp(Op::Not, {parseUnary()});
+        }
+        if (accept("+")) {
+            return parseUnary();
+        }
+        return parsePrimary();
+    }
+
+    NodePtr parsePrimary() {
+        skipSpaces();
+        if (pos == text.size()) {
+            fail("unexpected end");
+        }
+        char c = text[pos];
+        if (accept("(")) {
+            NodePtr inner = parseSelect();
+            expect(")");
+            return inner;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            const char* begin = text.c_str() + pos;
+            char* end = nullptr;
+            double value = std::strtod(begin, &end);
+            if (end == begin) {
+                fail("invalid number");
+            }
+            pos += end - begin;
+            return makeConstant(value);
+        }
+        if (c == '`') {
+            // quoted column name, for field names that aren't identifiers
+            size_t close = text.find('`', pos + 1);
+            if (close == std::string::npos) {
+                fail("unterminated column name");
+            }
+            std::string name = text.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+            return makeColumn(name);
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = pos;
+            while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) {
+                pos++;
+            }
+            std::string name = text.substr(start, pos - start);
+            if (!accept("(")) {
+                return makeColumn(name);
+            }
+            for (const auto& function : functions) {
+                if (name == function.name) {
+                    std::vector<NodePtr> args{parseSelect()};
+                    for (size_t i = 1; i < function.arity; ++i) {
+                        expect(",");
+                        args.push_back(parseSelect());
+                    }
+                    expect(")");
+                    return makeOp(function.op, std::move(args));
+                }
+            }
+            pos = start;
+            fail("unknown function '" + name + "'");
+        }
+        fail("unexpected '" + std::string(1, c) + "'");
+    }
+};
+
+DAG_INLINE NodePtr substitute(const NodePtr& node, const std::string& column, const NodePtr& replacement,
+                              std::map<const Node*, NodePtr>& substituted) {
+    if (node->op == Op::Column) {
+        return node->column == column ? replacement : node;
+    }
+    if (node->args.empty()) {
+        return node;
+    }
+    auto done = substituted.find(node.get());
+    if (done != substituted.end()) {
+        return done->second;
+    }
+    std::vector<NodePtr> args;
+    for (const auto& arg : node->args) {
+        args.push_back(substitute(arg, column, replacement, substituted));
+    }
+    return substituted[node.get()] = makeOp(node->op, std::move(args));
+}
+
+DAG_INLINE void print(const NodePtr& node, std::ostringstream& out) {
+    static const char* const symbols[] = {
+        "", "", "-", "!", "sqrt", "abs", "exp", "log", "sin", "cos", "floor", "ceil",
+        " + ", " - ", " * ", " / ", " % ", " < ", " <= ", " > ", " >= ", " == ", " != ", " && ", " || ", "pow", "min", "max"
+    };
+    const Op op = node->op;
+    if (op == Op::Constant) {
+        // inf and nan are not literals of the grammar
+        if (std::isnan(node->value)) {
+            out << "(0 / 0)";
+        } else if (std::isinf(node->value)) {
+            out << (node->value > 0 ? "(1 / 0)" : "(-1 / 0)");
+        } else {
+            out << node->value;
+        }
+    } else if (op == Op::Column) {
+        bool identifier = !node->column.empty() && !std::isdigit(static_cast<unsigned char>(node->column[0]))
+            && std::all_of(node->column.begin(), node->column.end(),
+                           [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+        out << (identifier ? node->column : "`" + node->column + "`");
+    } else if (op == Op::Select) {
+        out << "(";
+        print(node->args[0], out);
+        out << " ? ";
+        print(node->args[1], out);
+        out << " : ";
+        print(node->args[2], out);
+        out << ")";
+    } else if (op == Op::Neg || op == Op::Not) {
+        out << "(" << symbols[static_cast<size_t>(op)];
+        print(node->args[0], out);
+        out << ")";
+    } else if (op < Op::Add || op >= Op::Pow) {
+        out << symbols[static_cast<size_t>(op)] << "(";
+        for (size_t i = 0; i < node->args.size(); ++i) {
+            out << (i > 0 ? ", " : "");
+            print(node->args[i], out);
+        }
+        out << ")";
+    } else {
+        out << "(";
+        print(node->args[0], out);
+        out << symbols[static_cast<size_t>(op)];
+        print(node->args[1], out);
+        out << ")";
+    }
+}
+
+DAG_INLINE double toDouble(const DataContainer& value) {
+    return std::visit([&value](const auto& element) -> double {
+        using T = std::decay_t<decltype(element)>;
+        if constexpr (std::is_arithmetic_v<T>) {
+            return static_cast<double>(element);
+        } else {
+            throw std::invalid_argument(std::string("Expression input holds an element of type ")
+                                        + fieldTypeName(value.index()) + ", expected a number.");
+        }
+    }, value);
+}
+
+} // namespace expression_detail
+
+DAG_INLINE Expression::Expression(const std::string& text)
+    : Expression(expression_detail::Parser(text).parse()) {}
+
+DAG_INLINE Expression::Expression(std::shared_ptr<const Node> root) {
+    std::map<const Node*, std::shared_ptr<const Node>> folded;
+    this->root = fold(root, folded);
+    compile();
+}
+
+DAG_INLINE Expression Expression::substitute(const std::string& column, const Expression& replacement) const {
+    std::map<const Node*, std::shared_ptr<const Node>> substituted;
+    return Expression(expression_detail::substitute(root, column, replacement.root, substituted));
+}
+
+DAG_INLINE std::string Expression::toString() const {
+    std::ostringstream out;
+    out.precision(17);
+    expression_detail::print(root, out);
+    return out.str();
+}
+
+DAG_INLINE double Expression::apply(Op op, double a, double b, double c) {
+    switch (op) {
+        case Op::Neg: return -a;
+        case Op::Not: return a == 0.0 ? 1.0 : 0.0;
+        case Op::Sqrt: return std::sqrt(a);
+        case Op::Abs: return std::fabs(a);
+        case Op::Exp: return std::exp(a);
+        case Op::Log: return std::log(a);
+        case Op::Sin: return std::sin(a);
+        case Op::Cos: return std::cos(a);
+        case Op::Floor: return std::floor(a);
+        case Op::Ceil: return std::ceil(a);
+        case Op::Add: return a + b;
+        case Op::Sub: return a - b;
+        case Op::Mul: return a * b;
+        case Op::Div: return a / b;
+        case Op::Mod: return std::fmod(a, b);
+        case Op::Lt: return a < b ? 1.0 : 0.0;
+        case Op::Le: return a <= b ? 1.0 : 0.0;
+        case Op::Gt: return a > b ? 1.0 : 0.0;
+        case Op::Ge: return a >= b ? 1.0 : 0.0;
+        case Op::Eq: return a == b ? 1.0 : 0.0;
+        case Op::Ne: return a != b ? 1.0 : 0.0;
+        case Op::And: return a != 0.0 && b != 0.0 ? 1.0 : 0.0;
+        case Op::Or: return a != 0.0 || b != 0.0 ? 1.0 : 0.0;
+        case Op::Pow: return std::pow(a, b);
+        case Op::Min: return std::min(a, b);
+        case Op::Max: return std::max(a, b);
+        case Op::Select: return a != 0.0 ? b : c;
+        default: return 0.0;
+    }
+}
+
+DAG_INLINE std::shared_ptr<const Expression::Node> Expression::fold(const std::shared_ptr<const Node>& node,
+                                                                    std::map<const Node*, std::shared_ptr<const Node>>& folded) {
+    using namespace expression_detail;
+    if (node->args.empty()) {
+        return node;
+    }
+    auto done = folded.find(node.get());
+    if (done != folded.end()) {
+        return done->second;
+    }
+    return folded[node.get()] = foldArgs(node, folded);
+}
+
+DAG_INLINE std::shared_ptr<const Expression::Node> Expression::foldArgs(const std::shared_ptr<const Node>& node,
+                                                                        std::map<const Node*, std::shared_ptr<const Node>>& folded) {
+    using namespace expression_detail;
+    std::vector<NodePtr> args;
+    bool constant = true;
+    for (const auto& arg : node->args) {
+        args.push_back(fold(arg, folded));
+        constant = constant && args.back()->op == Op::Constant;
+    }
+    if (constant) {
+        double a = args[0]->value;
+        double b = args.size() > 1 ? args[1]->value : 0.0;
+        double c = args.size() > 2 ? args[2]->value : 0.0;
+        return makeConstant(apply(node->op, a, b, c));
+    }
+
+    // identities that hold for every double, x * 0 doesn't (inf, nan), nor x + 0 (-0 + 0 is 0);
+    // the zero that leaves every x unchanged is -0 for an addition and 0 for a subtraction
+    switch (node->op) {
+        case Op::Add:
+            if (isConstant(args[0], -0.0)) return args[1];
+            if (isConstant(args[1], -0.0)) return args[0];
+            break;
+        case Op::Sub:
+            if (isConstant(args[1], 0.0)) return args[0];
+            break;
+        case Op::Mul:
+            if (isConstant(args[0], 1.0)) return args[1];
+            if (isConstant(args[1], 1.0)) return args[0];
+            break;
+        case Op::Div:
+            if (isConstant(args[1], 1.0)) return args[0];
+            break;
+        case Op::Neg:
+            if (args[0]->op == Op::Neg) return args[0]->args[0];
+            break;
+        case Op::Select:
+            if (args[0]->op == Op::Constant) return args[0]->value != 0.0 ? args[1] : args[2];
+            break;
+        default:
+            break;
+    }
+    return makeOp(node->op, std::move(args));
+}
+
+DAG_INLINE void Expression::compile() {
+    // registers: the columns in order of first use from the left, then the constants, then the temporaries.
+    // Subtrees shared by pointer, e.g. the expression substituted twice by a fusion, are computed once.
+    // Constants are told apart by bit pattern, so -0 doesn't share the register of 0.
+    auto constantIndex = [this](double value) -> size_t {
+        return std::find_if(constants.begin(), constants.end(),
+                            [value](double c) { return expression_detail::sameBits(c, value); }) - constants.begin();
+    };
+    std::map<const Node*, size_t> uses;
+    std::vector<const Node*> stack{root.get()};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (uses[node]++ > 0) {
+            continue;
+        }
+        if (node->op == Op::Column && std::find(columns.begin(), columns.end(), node->column) == columns.end()) {
+            columns.push_back(node->column);
+        }
+        if (node->op == Op::Constant && constantIndex(node->value) == constants.size()) {
+            constants.push_back(node->value);
+        }
+        for (auto arg = node->args.rbegin(); arg != node->args.rend(); ++arg) {
+            stack.push_back(arg->get());
+        }
+    }
+
+    const size_t firstTemporary = columns.size() + constants.size();
+    numRegisters = firstTemporary;
+    std::vector<uint16_t> freeRegisters;
+    std::map<const Node*, uint16_t> computed;
+    auto checkRegister = [](size_t reg) {
+        if (reg > std::numeric_limits<uint16_t>::max()) {
+            throw std::invalid_argument("Expression needs too many registers.");
+        }
+        return static_cast<uint16_t>(reg);
+    };
+
+    // post-order emission; the destination is taken before the operands are freed, so it never aliases them,
+    // and a temporary is freed once every use of its subtree has been emitted
+    std::function<uint16_t(const Node*)> emit = [&](const Node* node) -> uint16_t {
+        if (node->op == Op::Column) {
+            return checkRegister(std::find(columns.begin(), columns.end(), node->column) - columns.begin());
+        }
+        if (node->op == Op::Constant) {
+            return checkRegister(columns.size() + constantIndex(node->value));
+        }
+        auto done = computed.find(node);
+        if (done != computed.end()) {
+            return done->second;
+        }
+        uint16_t operands[3] = {0, 0, 0};
+        for (size_t i = 0; i < node->args.size(); ++i) {
+            operands[i] = emit(node->args[i].get());
+        }
+        uint16_t dst;
+        if (freeRegisters.empty()) {
+            dst = checkRegister(numRegisters++);
+        } else {
+            dst = freeRegisters.back();
+            freeRegisters.pop_back();
+        }
+        for (size_t i = 0; i < node->args.size(); ++i) {
+            if (--uses[node->args[i].get()] == 0 && operands[i] >= firstTemporary) {
+                freeRegisters.push_back(operands[i]);
+            }
+        }
+        instructions.push_back(Instruction{node->op, dst, operands[0], operands[1], operands[2]});
+        computed[node] = dst;
+        return dst;
+    };
+    result = emit(root.get());
+}
+
+DAG_INLINE void Expression::execute(double* const* registers, size_t n) const {
+    // one tight loop per instruction and chunk, which the compiler vectorizes
+    for (const Instruction& instruction : instructions) {
+        double* d = registers[instruction.dst];
+        const double* a = registers[instruction.a];
+        const double* b = registers[instruction.b];
+        const double* c = registers[instruction.c];
+        switch (instruction.op) {
+            case Op::Neg: for (size_t i = 0; i < n; ++i) d[i] = -a[i]; break;
+            case Op::Not: for (size_t i = 0; i < n; ++i) d[i] = a[i] == 0.0 ? 1.0 : 0.0; break;
+            case Op::Sqrt: for (size_t i = 0; i < n; ++i) d[i] = std::sqrt(a[i]); break;
+            case Op::Abs: for (size_t i = 0; i < n; ++i) d[i] = std::fabs(a[i]); break;
+            case Op::Exp: for (size_t i = 0; i < n; ++i) d[i] = std::exp(a[i]); break;
+            case Op::Log: for (size_t i = 0; i < n; ++i) d[i] = std::log(a[i]); break;
+            case Op::Sin: for (size_t i = 0; i < n; ++i) d[i] = std::sin(a[i]); break;
+            case Op::Cos: for (size_t i = 0; i < n; ++i) d[i] = std::cos(a[i]); break;
+            case Op::Floor: for (size_t i = 0; i < n; ++i) d[i] = std::floor(a[i]); break;
+            case Op::Ceil: for (size_t i = 0; i < n; ++i) d[i] = std::ceil(a[i]); break;
+            case Op::Add: for (size_t i = 0; i < n; ++i) d[i] = a[i] + b[i]; break;
+            case Op::Sub: for (size_t i = 0; i < n; ++i) d[i] = a[i] - b[i]; break;
+            case Op::Mul: for (size_t i = 0; i < n; ++i) d[i] = a[i] * b[i]; break;
+            case Op::Div: for (size_t i = 0; i < n; ++i) d[i] = a[i] / b[i]; break;
+            case Op::Mod: for (size_t i = 0; i < n; ++i) d[i] = std::fmod(a[i], b[i]); break;
+            case Op::Lt: for (size_t i = 0; i < n; ++i) d[i] = a[i] < b[i] ? 1.0 : 0.0; break;
+            case Op::Le: for (size_t i = 0; i < n; ++i) d[i] = a[i] <= b[i] ? 1.0 : 0.0; break;
+            case Op::Gt: for (size_t i = 0; i < n; ++i) d[i] = a[i] > b[i] ? 1.0 : 0.0; break;
+            case Op::Ge: for (size_t i = 0; i < n; ++i) d[i] = a[i] >= b[i] ? 1.0 : 0.0; break;
+            case Op::Eq: for (size_t i = 0; i < n; ++i) d[i] = a[i] == b[i] ? 1.0 : 0.0; break;
+            case Op::Ne: for (size_t i = 0; i < n; ++i) d[i] = a[i] != b[i] ? 1.0 : 0.0; break;
+            case Op::And: for (size_t i = 0; i < n; ++i) d[i] = a[i] != 0.0 && b[i] != 0.0 ? 1.0 : 0.0; break;
+            case Op::Or: for (size_t i = 0; i < n; ++i) d[i] = a[i] != 0.0 || b[i] != 0.0 ? 1.0 : 0.0; break;
+            case Op::Pow: for (size_t i = 0; i < n; ++i) d[i] = std::pow(a[i], b[i]); break;
+            case Op::Min: for (size_t i = 0; i < n; ++i) d[i] = b[i] < a[i] ? b[i] : a[i]; break;
+            case Op::Max: for (size_t i = 0; i < n; ++i) d[i] = a[i] < b[i] ? b[i] : a[i]; break;
+            case Op::Select: for (size_t i = 0; i < n; ++i) d[i] = a[i] != 0.0 ? b[i] : c[i]; break;
+            default: break;
+        }
+    }
+}
+
+DAG_INLINE std::vector<double, BufferAllocator<double>> Expression::makeRegisters() const {
+    // one chunk per register; the column chunks are only used when the columns must be converted
+    std::vector<double, BufferAllocator<double>> storage(numRegisters * chunkSize);
+    for (size_t i = 0; i < constants.size(); ++i) {
+        std::fill_n(storage.data() + (columns.size() + i) * chunkSize, chunkSize, constants[i]);
+    }
+    return storage;
+}
+
+DAG_INLINE void Expression::evaluate(const std::vector<const double*>& columnData, size_t rows, double* out) const {
+    auto storage = makeRegisters();
+    std::vector<double*> registers(numRegisters);
+    for (size_t i = columns.size(); i < numRegisters; ++i) {
+        registers[i] = storage.data() + i * chunkSize;
+    }
+    for (size_t offset = 0; offset < rows; offset += chunkSize) {
+        size_t n = std::min(chunkSize, rows - offset);
+        // the column registers point into the inputs, nothing is copied
+        for (size_t i = 0; i < columns.size(); ++i) {
+            registers[i] = const_cast<double*>(columnData[i] + offset); // never a destination
+        }
+        execute(registers.data(), n);
+        std::copy_n(registers[result], n, out + offset);
+    }
+}
+
+DAG_INLINE void Expression::evaluate(const std::vector<const MiniBatch*>& columnData, MiniBatch& out) const {
+    size_t rows = columnData.empty() ? 0 : columnData[0]->size();
+    for (const MiniBatch* column : columnData) {
+        if (column->size() != rows) {
+            throw std::invalid_argument("Expression inputs have different sizes: " + std::to_string(rows) + " and "
+                                        + std::to_string(column->size()) + " elements.");
+        }
+    }
+    auto storage = makeRegisters();
+    std::vector<double*> registers(numRegisters);
+    for (size_t i = 0; i < numRegisters; ++i) {
+        registers[i] = storage.data() + i * chunkSize;
+    }
+    static_assert(chunkSize == 64, "a chunk covers one word of the validity bitmaps");
+    auto& outData = out.getData();
+    size_t first = outData.size();
+    outData.reserve(first + rows);
+    for (size_t offset = 0; offset < rows; offset += chunkSize) {
+        size_t n = std::min(chunkSize, rows - offset);
+        // rows valid in every column
+        uint64_t valid = ~uint64_t(0);
+        for (const MiniBatch* column : columnData) {
+            const auto& bits = column->getValidity();
+            if (offset / 64 < bits.size()) {
+                valid &= bits[offset / 64];
+            }
+        }
+        for (size_t i = 0; i < columns.size(); ++i) {
+            const auto& data = columnData[i]->getData();
+            if (valid == ~uint64_t(0)) {
+                for (size_t row = 0; row < n; ++row) {
+                    registers[i][row] = expression_detail::toDouble(data[offset + row]);
+                }
+            } else {
+                for (size_t row = 0; row < n; ++row) {
+                    registers[i][row] = (valid >> row) & 1 ? expression_detail::toDouble(data[offset + row]) : 0.0;
+                }
+            }
+        }
+        execute(registers.data(), n);
+        for (size_t row = 0; row < n; ++row) {
+            outData.emplace_back(registers[result][row]);
+        }
+        if (valid != ~uint64_t(0)) {
+            out.intersectValidity(first + offset, &valid, n);
+        }
+    }
+}
+
+DAG_INLINE double Expression::evaluate(const std::map<std::string, DataContainer>& row) const {
+    std::vector<double> values;
+    std::vector<const double*> columnData;
+    values.reserve(columns.size());
+    for (const auto& column : columns) {
+        auto it = row.find(column);
+        if (it == row.end()) {
+            throw std::invalid_argument("Expression column missing: " + column + ".");
+        }
+        values.push_back(expression_detail::toDouble(it->second));
+        columnData.push_back(&values.back());
+    }
+    double value = 0.0;
+    evaluate(columnData, 1, &value);
+    return value;
+}
+
+DAG_INLINE GraphNode makeExpressionNode(const std::string& output, std::shared_ptr<const Expression> expression) {
+    const auto& columns = expression->getColumns();
+    if (columns.empty()) {
+        throw std::invalid_argument("Expression node " + output + " reads no column: " + expression->toString() + ".");
+    }
+    if (std::find(columns.begin(), columns.end(), output) != columns.end()) {
+        throw std::invalid_argument("Expression node output " + output + " is also one of its inputs.");
+    }
+    // the element-wise process serves callers of GraphNode::execute, the executor runs the column process
+    GraphNode node(ComputeType::CPU, [expression, output](auto& inputs, auto& outputs) {
+        outputs[output] = expression->evaluate(inputs);
+    });
+    node.setColumnProcess([expression, output](const auto& inputs, auto& outputs) {
+        std::vector<const MiniBatch*> columnData;
+        for (const auto& column : expression->getColumns()) {
+            columnData.push_back(inputs.at(column));
+        }
+        expression->evaluate(columnData, *outputs.at(output));
+    });
+    for (const auto& column : columns) {
+        node.addInput(column, DataContainer());
+    }
+    node.addOutput(output, DataContainer());
+    node.setOutputType(output, fieldTypeOf<double>());
+    node.setExpression(std::move(expression));
+    return node;
+}
+
+DAG_INLINE GraphNode makeExpressionNode(const std::string& output, const std::string& text) {
+    return makeExpressionNode(output, std::make_shared<const Expression>(text));
+}
+
+DAG_INLINE Graph fuseExpressions(const Graph& graph, std::vector<size_t>* nodeMap) {
+    const size_t numNodes = graph.size();
+    std::vector<std::vector<size_t>> successors(numNodes);
+    std::vector<std::vector<PortEdge>> incoming(numNodes); // current port edges entering each node
+    std::vector<size_t> inDegree(numNodes, 0);
+    for (size_t from = 0; from < numNodes; ++from) {
+        for (size_t to = 0; to < numNodes; ++to) {
+            if (graph.edgeExists(from, to)) {
+                successors[from].push_back(to);
+                inDegree[to]++;
+                std::vector<PortEdge> ports = graph.getEdgePorts(from, to);
+                if (ports.empty()) {
+                    // dependency without data, kept with an empty port name
+                    ports.push_back(PortEdge{from, "", to, ""});
+                }
+                incoming[to].insert(incoming[to].end(), ports.begin(), ports.end());
+            }
+        }
+    }
+
+    std::vector<size_t> order;
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        if (inDegree[nodeId] == 0) {
+            order.push_back(nodeId);
+        }
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (size_t successor : successors[order[i]]) {
+            if (--inDegree[successor] == 0) {
+                order.push_back(successor);
+            }
+        }
+    }
+    if (order.size() != numNodes) {
+        throw std::logic_error("Cannot fuse a graph containing a cycle.");
+    }
+
+    // in topological order, so that a node has absorbed its own predecessors before it is fused forward
+    std::vector<std::shared_ptr<const Expression>> expressions(numNodes);
+    std::vector<bool> rebuilt(numNodes, false);
+    std::vector<size_t> fusedInto(numNodes, numNodes);
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        expressions[nodeId] = graph.getNode(nodeId).getExpression();
+    }
+    for (size_t a : order) {
+        if (!expressions[a] || successors[a].size() != 1) {
+            continue;
+        }
+        size_t b = successors[a][0];
+        std::vector<PortEdge> link;
+        std::vector<PortEdge> others;
+        for (const auto& port : incoming[b]) {
+            (port.from == a ? link : others).push_back(port);
+        }
+        const auto& outputs = graph.getNode(a).getOutputs();
+        if (!expressions[b] || link.size() != 1 || outputs.size() != 1 || link[0].outPort != outputs.begin()->first) {
+            continue;
+        }
+        // a root hands its inputs over to b, which must then be a root as well
+        if (incoming[a].empty() && !others.empty()) {
+            continue;
+        }
+        // the columns of a must not collide with the other columns of b, nor with the output of b
+        const auto& bColumns = expressions[b]->getColumns();
+        const std::string& bOutput = graph.getNode(b).getOutputs().begin()->first;
+        bool collides = std::any_of(expressions[a]->getColumns().begin(), expressions[a]->getColumns().end(),
+                                    [&](const std::string& column) {
+            return column == bOutput
+                || (column != link[0].inPort && std::find(bColumns.begin(), bColumns.end(), column) != bColumns.end());
+        });
+        if (collides) {
+            continue;
+        }
+
+        expressions[b] = std::make_shared<const Expression>(expressions[b]->substitute(link[0].inPort, *expressions[a]));
+        rebuilt[b] = true;
+        for (auto port : incoming[a]) {
+            port.to = b;
+            others.push_back(port);
+        }
+        incoming[b] = std::move(others);
+        for (const auto& port : incoming[a]) {
+            auto& list = successors[port.from];
+            std::replace(list.begin(), list.end(), a, b);
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+        fusedInto[a] = b;
+    }
+
+    Graph fused;
+    fused.setBufferReuse(graph.isBufferReuseEnabled());
+    std::vector<size_t> newIds(numNodes, numNodes);
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        if (fusedInto[nodeId] != numNodes) {
+            continue;
+        }
+        if (rebuilt[nodeId]) {
+            const std::string& output = graph.getNode(nodeId).getOutputs().begin()->first;
+            newIds[nodeId] = fused.addNode(makeExpressionNode(output, expressions[nodeId]));
+        } else {
+            newIds[nodeId] = fused.addNode(graph.getNode(nodeId));
+        }
+    }
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        if (newIds[nodeId] == numNodes) {
+            continue;
+        }
+        const auto& inputs = fused.getNode(newIds[nodeId]).getInputs();
+        for (const auto& port : incoming[nodeId]) {
+            if (port.outPort.empty()) {
+                fused.addOrderingEdge(newIds[port.from], newIds[nodeId]);
+            } else if (inputs.find(port.inPort) != inputs.end()) {
+                // folding may have dropped the column the port fed
+                fused.addEdge(newIds[port.from], port.outPort, newIds[nodeId], port.inPort);
+            }
+        }
+    }
+
+    if (nodeMap != nullptr) {
+        nodeMap->assign(numNodes, numNodes);
+        for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+            size_t target = nodeId;
+            while (fusedInto[target] != numNodes) {
+                target = fusedInto[target];
+            }
+            (*nodeMap)[nodeId] = newIds[target];
+        }
+    }
+    return fused;
+}
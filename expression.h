@@ -0,0 +1,239 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/27
+
+/**
+ * @file expression.h
+ *
+ * @brief Arithmetic expression nodes evaluated column at a time by a register-based bytecode.
+ *
+ * An Expression is parsed from text such as `x > 0 ? sqrt(x) * 2 : -x`, constant-folded, and compiled
+ * once into bytecode whose registers each hold a chunk of rows. Every instruction is a tight loop over a
+ * chunk, which the compiler vectorizes. Expression nodes run on whole MiniBatches instead of element by
+ * element, and chains of expression nodes can be fused into a single node by fuseExpressions().
+ *
+ * Grammar, from the lowest precedence: `c ? a : b`, `||`, `&&`, `== !=`, `< <= > >=`, `+ -`, `* / %`,
+ * unary `- ! +`, then numbers, column names, parentheses and the functions sqrt, abs, exp, log, sin, cos,
+ * floor, ceil (one argument), pow, min, max (two arguments). Every value is a double; comparisons and
+ * logical operators yield 1 or 0, and any nonzero value is true.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dag_config.h"
+#include "buffer_allocator.h"
+#include "graph.h"
+
+class Expression {
+public:
+    static constexpr size_t chunkSize = 64; ///< Number of rows held by a register.
+
+    /**
+     * @brief Operations of the syntax tree and of the bytecode.
+     */
+    enum class Op : uint8_t {
+        Constant, Column, // leaves, only in the syntax tree
+        Neg, Not, Sqrt, Abs, Exp, Log, Sin, Cos, Floor, Ceil, // one operand
+        Add, Sub, Mul, Div, Mod, Lt, Le, Gt, Ge, Eq, Ne, And, Or, Pow, Min, Max, // two operands
+        Select // three operands: condition, value if true, value if false
+    };
+
+    /**
+     * @brief A node of the syntax tree.
+     */
+    struct Node {
+        Op op; ///< The operation.
+        double value = 0.0; ///< The value of a constant.
+        std::string column; ///< The name of a column.
+        std::vector<std::shared_ptr<const Node>> args; ///< The operands.
+    };
+
+    /**
+     * @brief A bytecode instruction: dst = op(a, b, c) over one chunk of every register.
+     */
+    struct Instruction {
+        Op op; ///< The operation.
+        uint16_t dst; ///< The destination register.
+        uint16_t a; ///< The first operand register.
+        uint16_t b; ///< The second operand register, if any.
+        uint16_t c; ///< The third operand register, if any.
+    };
+
+    /**
+     * @brief Parses, folds and compiles an expression.
+     *
+     * @param text The expression.
+     * @throws std::invalid_argument If the expression is malformed.
+     */
+    explicit Expression(const std::string& text);
+
+    /**
+     * @brief Folds and compiles a syntax tree.
+     *
+     * @param root The root of the syntax tree.
+     */
+    explicit Expression(std::shared_ptr<const Node> root);
+
+    /**
+     * @brief Replaces a column by another expression, e.g. to fuse two expression nodes.
+     *
+     * @param column The name of the column to replace.
+     * @param replacement The expression computing the column.
+     * @return The combined expression, folded and compiled again.
+     */
+    Expression substitute(const std::string& column, const Expression& replacement) const;
+
+    /**
+     * @brief Evaluates the expression over columns of doubles.
+     *
+     * @param columns One array of rows per column, in the order of getColumns().
+     * @param rows The number of rows.
+     * @param out Receives one result per row.
+     */
+    void evaluate(const std::vector<const double*>& columns, size_t rows, double* out) const;
+
+    /**
+     * @brief Evaluates the expression over MiniBatches, appending one double per row to the output.
+     *
+     * A row is null in the output if it is null in any column: the validity bitmaps of the columns are
+     * combined a word per chunk, and the null rows are computed from 0.0 without being read.
+     *
+     * @param columns One MiniBatch per column, in the order of getColumns(), all of the same size.
+     * @param out The output MiniBatch.
+     * @throws std::invalid_argument If the sizes differ or a valid element is not a number.
+     */
+    void evaluate(const std::vector<const MiniBatch*>& columns, MiniBatch& out) const;
+
+    /**
+     * @brief Evaluates the expression for a single row.
+     *
+     * @param row The value of every column.
+     * @return The result.
+     * @throws std::invalid_argument If a column is missing or not a number.
+     */
+    double evaluate(const std::map<std::string, DataContainer>& row) const;
+
+    /**
+     * @brief Gets the names of the columns read by the expression, in order of first use.
+     */
+    const std::vector<std::string>& getColumns() const {
+        return columns;
+    }
+
+    /**
+     * @brief Gets the compiled bytecode.
+     */
+    const std::vector<Instruction>& getInstructions() const {
+        return instructions;
+    }
+
+    /**
+     * @brief Gets the folded syntax tree.
+     */
+    const std::shared_ptr<const Node>& getRoot() const {
+        return root;
+    }
+
+    /**
+     * @brief Prints the folded expression, fully parenthesized.
+     *
+     * @return The expression text.
+     */
+    std::string toString() const;
+
+private:
+    std::shared_ptr<const Node> root; ///< The folded syntax tree.
+    std::vector<std::string> columns; ///< Columns, held by registers 0 to columns.size() - 1.
+    std::vector<double> constants; ///< Constants, held by the registers following the columns.
+    std::vector<Instruction> instructions; ///< The bytecode.
+    size_t numRegisters = 0; ///< Number of registers, columns and constants included.
+    uint16_t result = 0; ///< Register holding the result.
+
+    /**
+     * @brief Folds constant subexpressions and trivial identities.
+     *
+     * @param node The subtree to fold.
+     * @param folded The subtrees already folded, so that shared subtrees stay shared.
+     */
+    static std::shared_ptr<const Node> fold(const std::shared_ptr<const Node>& node,
+                                            std::map<const Node*, std::shared_ptr<const Node>>& folded);
+
+    /**
+     * @brief Folds the operands of an operation, then the operation itself.
+     */
+    static std::shared_ptr<const Node> foldArgs(const std::shared_ptr<const Node>& node,
+                                                std::map<const Node*, std::shared_ptr<const Node>>& folded);
+
+    /**
+     * @brief Applies an operation to scalars, used for folding and by the bytecode.
+     */
+    static double apply(Op op, double a, double b, double c);
+
+    /**
+     * @brief Compiles the syntax tree into bytecode.
+     */
+    void compile();
+
+    /**
+     * @brief Runs the bytecode over n rows held by the registers.
+     *
+     * @param registers One chunk per register.
+     * @param n The number of rows, at most chunkSize.
+     */
+    void execute(double* const* registers, size_t n) const;
+
+    /**
+     * @brief Allocates the registers and fills the constant registers.
+     */
+    std::vector<double, BufferAllocator<double>> makeRegisters() const;
+};
+
+/**
+ * @brief Creates a node computing an expression over its input fields.
+ *
+ * The inputs of the node are the columns of the expression, its single output has type double. The node
+ * processes whole MiniBatches at a time; its inputs must all have the same number of elements.
+ *
+ * @param output The name of the output field.
+ * @param expression The expression.
+ * @return The node.
+ * @throws std::invalid_argument If the expression reads no column, since the row count comes from
+ *         the columns, or if the output is also one of them.
+ */
+GraphNode makeExpressionNode(const std::string& output, std::shared_ptr<const Expression> expression);
+
+/**
+ * @brief Creates a node computing an expression over its input fields.
+ *
+ * @param output The name of the output field.
+ * @param text The expression.
+ * @return The node.
+ * @throws std::invalid_argument If the expression is malformed or reads no column.
+ */
+GraphNode makeExpressionNode(const std::string& output, const std::string& text);
+
+/**
+ * @brief Fuses chains of expression nodes into single nodes.
+ *
+ * An expression node whose output is read by a single expression node, and by nothing else, is
+ * substituted into it, so the intermediate MiniBatch is never materialized. The fused expression is
+ * constant-folded again. A pair is left unfused when a column of the first node is another column or the
+ * output of the second, since the fused node couldn't tell them apart. Nodes that aren't fused keep their
+ * ports and edges.
+ *
+ * @param graph The graph to fuse.
+ * @param nodeMap If not null, receives the ID in the fused graph of every node of the graph, or the ID
+ *                of the node it was fused into.
+ * @return The fused graph.
+ */
+Graph fuseExpressions(const Graph& graph, std::vector<size_t>* nodeMap = nullptr);
+
+#ifdef DAG_HEADER_ONLY
+    #include "expression.cpp"
+#endif
@@ -0,0 +1,440 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/6
+
+/**
+ * @file graph.cpp
+ *
+ * @brief Implements the Graph class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by graph.h otherwise.
+ */
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <set>
+
+DAG_INLINE size_t Graph::addNode(GraphNode node) {
+    size_t nodeId = nodes.size();
+    nodes.push_back(std::move(node));
+    // update adjacency list, a new node has no edge yet
+    adjacencyList.push_back(std::vector<size_t>());
+    inDegrees.push_back(0);
+    rootNodes.push_back(nodeId);
+    // update batch data
+    for (auto& nodeBatches : batchData) {
+        nodeBatches.push_back(std::unordered_map<std::string, MiniBatch>());
+    }
+    compiled = false;
+    return nodeId;
+}
+
+DAG_INLINE bool Graph::addEdge(size_t from, size_t to) {
+    if (from < nodes.size() && to < nodes.size() && !createsCycle(from, to) && matchingIO(from, to)) {
+        insertEdge(from, to);
+        auto ordering = explicitPorts.find({from, to});
+        if (ordering != explicitPorts.end() && ordering->second.empty()) {
+            explicitPorts.erase(ordering); // an ordering edge now passes the matching fields
+        }
+        compiled = false;
+        return true;
+    }
+    if (createsCycle(from, to)) {
+        std::cout << "create cycle failed" << std::endl;
+    }
+    if (!matchingIO(from, to)) {
+        std::cout << "matching IO failed" << std::endl;
+    }
+    return false; // 边未被添加
+}
+
+DAG_INLINE bool Graph::addEdge(size_t from, const std::string& outPort, size_t to, const std::string& inPort) {
+    if (from >= nodes.size() || to >= nodes.size()) {
+        return false;
+    }
+    if (nodes[from].getOutputs().find(outPort) == nodes[from].getOutputs().end()
+        || nodes[to].getInputs().find(inPort) == nodes[to].getInputs().end()) {
+        std::cout << "matching ports failed" << std::endl;
+        return false;
+    }
+    if (createsCycle(from, to)) {
+        std::cout << "create cycle failed" << std::endl;
+        return false;
+    }
+    auto& ports = explicitPorts[{from, to}];
+    for (const auto& port : ports) {
+        if (port.outPort == outPort && port.inPort == inPort) {
+            return true;
+        }
+    }
+    ports.push_back(PortEdge{from, outPort, to, inPort});
+    insertEdge(from, to);
+    compiled = false;
+    return true;
+}
+
+DAG_INLINE bool Graph::addOrderingEdge(size_t from, size_t to) {
+    if (from >= nodes.size() || to >= nodes.size()) {
+        return false;
+    }
+    if (edgeExists(from, to)) {
+        return true;
+    }
+    if (createsCycle(from, to)) {
+        std::cout << "create cycle failed" << std::endl;
+        return false;
+    }
+    explicitPorts[{from, to}]; // no port connection: no field is passed
+    insertEdge(from, to);
+    compiled = false;
+    return true;
+}
+
+DAG_INLINE size_t Graph::reduceTransitiveEdges() {
+    requireCompiled();
+    const size_t words = (nodes.size() + 63) / 64;
+    std::vector<size_t> position(nodes.size());
+    for (size_t i = 0; i < topologicalOrder.size(); ++i) {
+        position[topologicalOrder[i]] = i;
+    }
+
+    // reachable[u] holds the nodes reachable from u through at least one edge
+    std::vector<uint64_t> reachable(nodes.size() * words, 0);
+    size_t removed = 0;
+    for (auto it = topologicalOrder.rbegin(); it != topologicalOrder.rend(); ++it) {
+        size_t from = *it;
+        uint64_t* fromBits = &reachable[from * words];
+        std::vector<size_t> next = successors[from];
+        std::sort(next.begin(), next.end(), [&position](size_t a, size_t b) { return position[a] < position[b]; });
+        for (size_t to : next) {
+            bool implied = (fromBits[to / 64] >> (to % 64)) & 1;
+            auto ports = explicitPorts.find({from, to});
+            if (implied && ports != explicitPorts.end() && ports->second.empty()) {
+                eraseEdge(from, to);
+                explicitPorts.erase(ports);
+                ++removed;
+                continue;
+            }
+            const uint64_t* toBits = &reachable[to * words];
+            for (size_t word = 0; word < words; ++word) {
+                fromBits[word] |= toBits[word];
+            }
+            fromBits[to / 64] |= uint64_t(1) << (to % 64);
+        }
+    }
+    if (removed != 0) {
+        compile();
+    }
+    return removed;
+}
+
+DAG_INLINE std::vector<PortEdge> Graph::getEdgePorts(size_t from, size_t to) const {
+    auto it = explicitPorts.find({from, to});
+    if (it != explicitPorts.end()) {
+        return it->second;
+    }
+    std::vector<PortEdge> ports;
+    const auto& toInputs = nodes.at(to).getInputs();
+    for (const auto& output : nodes.at(from).getOutputs()) {
+        if (toInputs.find(output.first) != toInputs.end()) {
+            ports.push_back(PortEdge{from, output.first, to, output.first});
+        }
+    }
+    return ports;
+}
+
+DAG_INLINE bool Graph::createsCycle(size_t from, size_t to) {
+    // the edge closes a cycle if the source is reachable from the destination
+    std::vector<bool> visited(nodes.size(), false);
+    std::vector<size_t> stack(1, to);
+    visited[to] = true;
+    while (!stack.empty()) {
+        size_t current = stack.back();
+        stack.pop_back();
+        if (current == from) {
+            return true;
+        }
+        for (size_t next : adjacencyList[current]) {
+            if (!visited[next]) {
+                visited[next] = true;
+                stack.push_back(next);
+            }
+        }
+    }
+    return false;
+}
+
+DAG_INLINE bool Graph::hasCycle() {
+    // Kahn's algorithm leaves the nodes of cycles, and those behind them, unvisited
+    std::vector<size_t> inDegree = inDegrees;
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (inDegree[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+    size_t visited = 0;
+    while (!ready.empty()) {
+        size_t current = ready.back();
+        ready.pop_back();
+        ++visited;
+        for (size_t next : adjacencyList[current]) {
+            if (--inDegree[next] == 0) {
+                ready.push_back(next);
+            }
+        }
+    }
+    return visited != nodes.size();
+}
+
+DAG_INLINE void Graph::printGraph() {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        std::cout << "Node " << i << ":\n";
+        for (size_t j : adjacencyList[i]) {
+            std::cout << "  Edge to Node " << j << "\n";
+        }
+    }
+    std::cout << "\n";
+}
+
+DAG_INLINE void Graph::printRoots() {
+    std::cout << "Root nodes: ";
+    for (const auto& root : rootNodes) {
+        std::cout << root << " ";
+    }
+    std::cout << "\n";
+}
+
+DAG_INLINE bool Graph::isReady(size_t nodeId, size_t batchId) {
+    const auto& node = nodes[nodeId];
+    const auto& inputFields = node.getInputs();
+
+    for (const auto& field : inputFields) {
+        const auto& fieldName = field.first;
+        if (batchData[nodeId][batchId].find(fieldName) == batchData[nodeId][batchId].end()) {
+            return false; // if any input field is missing, the node is not ready
+        }
+    }
+
+    return true; // all input fields are present
+}
+
+DAG_INLINE void Graph::initMiniBatches(size_t numBatches) {
+    batchData.resize(nodes.size()); // 确保batchData的大小与节点数量一致
+    for (size_t nodeId = 0; nodeId < nodes.size(); nodeId++) {
+        auto& nodeBatches = batchData[nodeId];
+        nodeBatches.resize(numBatches);
+
+        for (auto& batch : nodeBatches) {
+            const auto& inputs = nodes[nodeId].getInputs();
+            const auto& outputs = nodes[nodeId].getOutputs();
+            for (const auto& input : inputs) {
+                // initialize only MiniBatches that have not been set
+                if (batch.find(input.first) == batch.end()) {
+                    batch[input.first] = MiniBatch();
+                }
+            }
+            for (const auto& output : outputs) {
+                // initialize only MiniBatches that have not been set
+                if (batch.find(output.first) == batch.end()) {
+                    batch[output.first] = MiniBatch();
+                }
+            }
+        }
+    }
+}
+
+DAG_INLINE bool Graph::isRoot(size_t nodeIndex) {
+    return inDegrees[nodeIndex] == 0; // 没有入边，是根节点
+}
+
+DAG_INLINE std::vector<std::string> Graph::validate() const {
+    std::vector<std::string> problems;
+    std::vector<std::vector<size_t>> incoming(nodes.size());
+    for (size_t from = 0; from < nodes.size(); ++from) {
+        for (size_t to : adjacencyList[from]) {
+            incoming[to].push_back(from);
+        }
+    }
+    for (size_t to = 0; to < nodes.size(); ++to) {
+        const GraphNode& node = nodes[to];
+        bool root = incoming[to].empty();
+        std::set<std::string> connected;
+        for (size_t from : incoming[to]) {
+            for (const auto& port : getEdgePorts(from, to)) {
+                connected.insert(port.inPort);
+                FieldType outputType = nodes[from].getOutputType(port.outPort);
+                FieldType inputType = node.getInputType(port.inPort);
+                if (outputType != untypedField && inputType != untypedField && outputType != inputType) {
+                    problems.push_back("Field '" + port.outPort + "' of node " + std::to_string(from) + " is "
+                                       + fieldTypeName(outputType) + " but input '" + port.inPort + "' of node "
+                                       + std::to_string(to) + " is " + fieldTypeName(inputType) + ".");
+                }
+            }
+        }
+        // inputs of root nodes are provided by the input batches, checked by the executor
+        if (root) {
+            continue;
+        }
+        for (const auto& inputField : node.getInputs()) {
+            if (node.isInputRequired(inputField.first) && connected.find(inputField.first) == connected.end()) {
+                problems.push_back("Input '" + inputField.first + "' of node " + std::to_string(to)
+                                   + " is not produced by any predecessor.");
+            }
+        }
+    }
+    return problems;
+}
+
+DAG_INLINE void Graph::compile() {
+    std::vector<std::string> problems = validate();
+    if (!problems.empty()) {
+        std::string message = "Invalid graph:";
+        for (const auto& problem : problems) {
+            message += " " + problem;
+        }
+        throw std::logic_error(message);
+    }
+
+    successors.assign(nodes.size(), std::vector<size_t>());
+    predecessors.assign(nodes.size(), std::vector<size_t>());
+    connections.assign(nodes.size(), std::vector<PortEdge>());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (size_t j : adjacencyList[i]) {
+            successors[i].push_back(j);
+            predecessors[j].push_back(i);
+            std::vector<PortEdge> ports = getEdgePorts(i, j);
+            connections[i].insert(connections[i].end(), ports.begin(), ports.end());
+        }
+    }
+
+    // Kahn's algorithm, nodes with the same depth keep their insertion order
+    topologicalOrder.clear();
+    topologicalOrder.reserve(nodes.size());
+    std::vector<size_t> inDegree(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        inDegree[i] = predecessors[i].size();
+        if (inDegree[i] == 0) {
+            topologicalOrder.push_back(i);
+        }
+    }
+    for (size_t head = 0; head < topologicalOrder.size(); ++head) {
+        for (size_t successor : successors[topologicalOrder[head]]) {
+            if (--inDegree[successor] == 0) {
+                topologicalOrder.push_back(successor);
+            }
+        }
+    }
+    if (topologicalOrder.size() != nodes.size()) {
+        throw std::logic_error("Graph contains a cycle.");
+    }
+
+    bufferAssignment = BufferAssignment();
+    if (bufferReuse) {
+        bufferAssignment = MemoryPlanner(nodes, successors, connections, FieldSizes()).assignBuffers(topologicalOrder);
+    }
+    compiled = true;
+}
+
+DAG_INLINE MemoryEstimate Graph::estimatePeakMemory(const FieldSizes& fieldSizes, const std::vector<size_t>& batchSizes) const {
+    std::vector<ScheduleStep> schedule;
+    schedule.reserve(nodes.size() * batchSizes.size());
+    for (size_t batchId = 0; batchId < batchSizes.size(); ++batchId) {
+        for (size_t nodeId : getTopologicalOrder()) {
+            schedule.push_back({nodeId, batchId});
+        }
+    }
+    return estimatePeakMemory(fieldSizes, batchSizes, schedule);
+}
+
+DAG_INLINE MemoryEstimate Graph::estimatePeakMemory(const FieldSizes& fieldSizes, const std::vector<size_t>& batchSizes,
+    const std::vector<ScheduleStep>& schedule) const {
+    requireCompiled();
+    return MemoryPlanner(nodes, successors, connections, fieldSizes).estimate(batchSizes, schedule);
+}
+
+DAG_INLINE MemoryPlan Graph::planMemory(const FieldSizes& fieldSizes, const std::vector<size_t>& batchSizes) const {
+    requireCompiled();
+    return MemoryPlanner(nodes, successors, connections, fieldSizes).plan(batchSizes);
+}
+
+DAG_INLINE TaskClusters Graph::coarsen(const std::vector<double>& costs, double grainSeconds) const {
+    requireCompiled();
+    if (costs.size() != nodes.size()) {
+        throw std::invalid_argument("Expected one cost per node.");
+    }
+    TaskClusters clusters;
+    clusters.clusterOf.assign(nodes.size(), 0);
+    std::vector<double> clusterCosts;
+    for (size_t nodeId : topologicalOrder) {
+        const auto& preds = predecessors[nodeId];
+        bool cheap = costs[nodeId] < grainSeconds;
+        if (cheap && !preds.empty()) {
+            size_t cluster = clusters.clusterOf[preds.front()];
+            bool joins = costs[clusters.members[cluster].front()] < grainSeconds
+                         && clusterCosts[cluster] + costs[nodeId] <= grainSeconds
+                         && std::all_of(preds.begin(), preds.end(), [&](size_t predecessor) {
+                                return clusters.clusterOf[predecessor] == cluster;
+                            });
+            if (joins) {
+                clusters.clusterOf[nodeId] = cluster;
+                clusters.members[cluster].push_back(nodeId);
+                clusterCosts[cluster] += costs[nodeId];
+                continue;
+            }
+        }
+        clusters.clusterOf[nodeId] = clusters.members.size();
+        clusters.members.push_back({nodeId});
+        clusterCosts.push_back(costs[nodeId]);
+    }
+    return clusters;
+}
+
+DAG_INLINE void Graph::insertEdge(size_t from, size_t to) {
+    auto& destinations = adjacencyList[from];
+    auto it = std::lower_bound(destinations.begin(), destinations.end(), to);
+    if (it != destinations.end() && *it == to) {
+        return;
+    }
+    destinations.insert(it, to);
+    if (inDegrees[to]++ == 0) {
+        rootNodes.erase(std::lower_bound(rootNodes.begin(), rootNodes.end(), to));
+    }
+}
+
+DAG_INLINE void Graph::eraseEdge(size_t from, size_t to) {
+    auto& destinations = adjacencyList[from];
+    auto it = std::lower_bound(destinations.begin(), destinations.end(), to);
+    if (it == destinations.end() || *it != to) {
+        return;
+    }
+    destinations.erase(it);
+    if (--inDegrees[to] == 0) {
+        rootNodes.insert(std::lower_bound(rootNodes.begin(), rootNodes.end(), to), to);
+    }
+}
+
+DAG_INLINE bool Graph::matchingIO(size_t from, size_t to) {
+    auto& fromOutputs = nodes[from].getOutputs();
+    auto& toInputs = nodes[to].getInputs();
+
+    for (const auto& output : fromOutputs) {
+        if (toInputs.find(output.first) != toInputs.end()) {
+            return true; // found a matching field
+        }
+    }
+    return false; // no matching field found
+}
+
+DAG_INLINE void Graph::updateRoots() {
+    rootNodes.clear();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (isRoot(i)) {
+            rootNodes.push_back(i);
+        }
+    }
+}
@@ -1,330 +1,459 @@
-// Copyright (C) 2024 Haochen Jiang
-//
-// Authors: Haochen Jiang
-// Date: 2024/1/2
-
-/**
- * @file graph.h
- *
- * @brief Represents a computational graph capable of processing data through interconnected nodes.
- *
- * The Graph class manages a collection of interconnected GraphNodes, forming a directed graph.
- * It supports operations like adding nodes, creating edges, and executing computations across the graph.
- */
-
-#pragma once
-
-#include <vector>
-#include "graph_node.h"
-#include "mini_batch.h"
-
-class Graph {
-public:
-    /**
-     * @brief Default constructor for Graph.
-     */
-    Graph() : batchData(0) {} // initialize batch size to be 0
-    
-    /**
-     * @brief Adds a new node to the graph.
-     *
-     * @param node The GraphNode to be added.
-     * @return The ID (index) of the newly added node.
-     */
-    size_t addNode(GraphNode node) {
-        size_t nodeId = nodes.size();
-        nodes.push_back(std::move(node));
-        // update adjacency list
-        adjacencyList.push_back(std::vector<bool>(nodeId + 1, false));
-        for (auto &row : adjacencyList) {
-            row.resize(nodes.size(), false);
-        }
-        // update batch data
-        for (auto& nodeBatches : batchData) {
-            nodeBatches.push_back(std::unordered_map<std::string, MiniBatch>());
-        }
-        updateRoots();
-        return nodeId;
-    }
-
-    /**
-     * @brief Adds an edge from one node to another.
-     *
-     * @param from The ID of the source node.
-     * @param to The ID of the destination node.
-     * @return True if the edge is added successfully, false otherwise.
-     */
-    bool addEdge(size_t from, size_t to) {
-        if (from < nodes.size() && to < nodes.size() && !createsCycle(from, to) && matchingIO(from, to)) {
-            adjacencyList[from][to] = true;
-            updateRoots(); // 更新根节点
-            return true;
-        }
-        if (createsCycle(from, to)) {
-            std::cout << "create cycle failed" << std::endl;
-        }
-        if (!matchingIO(from, to)) {
-            std::cout << "matching IO failed" << std::endl;
-        }
-        return false; // 边未被添加
-    }
-
-    /**
-     * @brief Retrieves a reference to a node by its ID.
-     *
-     * @param index The ID of the node.
-     * @return A reference to the requested node.
-     */
-    GraphNode& getNode(size_t index) {
-        return nodes.at(index);
-    }
-
-    /**
-     * @brief Returns the number of nodes in the graph.
-     *
-     * @return The number of nodes.
-     */
-    size_t size() const {
-        return nodes.size();
-    }
-
-    /**
-     * @brief Checks if an edge exists between two nodes.
-     *
-     * @param from The ID of the source node.
-     * @param to The ID of the destination node.
-     * @return True if the edge exists, false otherwise.
-     */
-    bool edgeExists(size_t from, size_t to) const {
-        return from < nodes.size() && to < nodes.size() && adjacencyList[from][to];
-    }
-
-    /**
-     * @brief Checks if adding an edge would create a cycle in the graph.
-     *
-     * @param from The ID of the source node.
-     * @param to The ID of the destination node.
-     * @return True if adding the edge creates a cycle, false otherwise.
-     */
-    bool createsCycle(size_t from, size_t to) {
-        // temporarily add the edge and check if a cycle is created
-        adjacencyList[from][to] = true;
-
-        bool flag = hasCycle();
-
-        adjacencyList[from][to] = false;
-
-        return flag;
-    }
-
-    /**
-     * @brief Checks if the graph has any cycles.
-     *
-     * @return True if the graph contains cycles, false otherwise.
-     */
-    bool hasCycle() {
-        std::vector<bool> visited(nodes.size(), false);
-        std::vector<bool> recStack(nodes.size(), false); // 用于记录递归堆栈
-
-        for (size_t i = 0; i < nodes.size(); ++i) {
-            if (!visited[i]) {
-                if (dfs(i, visited, recStack)) {
-                    return true; // 发现回路
-                }
-            }
-        }
-        return false; // 整个图中未找到回路
-    }
-
-    /**
-     * @brief Prints the structure of the graph.
-     */
-    void printGraph() {
-        for (size_t i = 0; i < nodes.size(); ++i) {
-            std::cout << "Node " << i << ":\n";
-            for (size_t j = 0; j < nodes.size(); ++j) {
-                if (adjacencyList[i][j]) {
-                    std::cout << "  Edge to Node " << j << "\n";
-                }
-            }
-        }
-        std::cout << "\n";
-    }
-
-    /**
-     * @brief Prints the IDs of all root nodes in the graph.
-     */
-    void printRoots() {
-        std::cout << "Root nodes: ";
-        for (const auto& root : rootNodes) {
-            std::cout << root << " ";
-        }
-        std::cout << "\n";
-    }
-
-    /**
-     * @brief Checks if a node is ready for processing, based on the availability of input data.
-     *
-     * @param nodeId The ID of the node.
-     * @param batchId The ID of the batch to check.
-     * @return True if the node is ready, false otherwise.
-     */
-    bool isReady(size_t nodeId, size_t batchId) {
-        const auto& node = nodes[nodeId];
-        const auto& inputFields = node.getInputs();
-
-        for (const auto& field : inputFields) {
-            const auto& fieldName = field.first;
-            if (batchData[nodeId][batchId].find(fieldName) == batchData[nodeId][batchId].end()) {
-                return false; // if any input field is missing, the node is not ready
-            }
-        }
-
-        return true; // all input fields are present
-    }
-    
-    /**
-     * @brief Retrieves a specific MiniBatch for a node.
-     *
-     * @param nodeId The ID of the node.
-     * @param batchId The ID of the batch.
-     * @param fieldName The name of the field.
-     * @return A reference to the requested MiniBatch.
-     */
-    MiniBatch& getMiniBatch(size_t nodeId, size_t batchId, const std::string& fieldName) {
-        return batchData[nodeId][batchId][fieldName];
-    }
-
-    /**
-     * @brief Retrieves all MiniBatches for a node.
-     *
-     * @param nodeId The ID of the node.
-     * @return A reference to the vector of MiniBatch maps for the node.
-     */
-    std::vector<std::unordered_map<std::string, MiniBatch>>& getNodeMiniBatches(size_t nodeId) {
-        if (nodeId >= batchData.size()) {
-            throw std::out_of_range("Node ID out of range.");
-        }
-
-        return batchData[nodeId];
-    }
-
-    /**
-     * @brief Initializes the MiniBatch structures for all nodes.
-     *
-     * @param numBatches The number of batches to initialize for each node.
-     */
-    void initMiniBatches(size_t numBatches) {
-        batchData.resize(nodes.size()); // 确保batchData的大小与节点数量一致
-        for (size_t nodeId = 0; nodeId < nodes.size(); nodeId++) {
-            auto& nodeBatches = batchData[nodeId];
-            nodeBatches.resize(numBatches);
-
-            for (auto& batch : nodeBatches) {
-                const auto& inputs = nodes[nodeId].getInputs();
-                const auto& outputs = nodes[nodeId].getOutputs();
-                for (const auto& input : inputs) {
-                    // initialize only MiniBatches that have not been set
-                    if (batch.find(input.first) == batch.end()) {
-                        batch[input.first] = MiniBatch();
-                    }
-                }
-                for (const auto& output : outputs) {
-                    // initialize only MiniBatches that have not been set
-                    if (batch.find(output.first) == batch.end()) {
-                        batch[output.first] = MiniBatch();
-                    }
-                }
-            }
-        }
-    }
-
-    /**
-     * @brief Retrieves a list of all root nodes in the graph.
-     *
-     * @return A vector containing the IDs of all root nodes.
-     */
-    const std::vector<size_t> getRootNodes() const {
-        return rootNodes;
-    }
-
-    /**
-     * @brief Checks if a node is a root node.
-     * 
-     * @param nodeIndex The index of the node to check.
-     * @return True if the node is a root node, false otherwise.
-     */
-    bool isRoot(size_t nodeIndex) {
-        for (const auto& row : adjacencyList) {
-            if (row[nodeIndex]) {
-                return false; // 找到一条指向该节点的边
-            }
-        }
-        return true; // 没有入边，是根节点
-    }
-
-private:
-    std::vector<GraphNode> nodes; // Stores all nodes in the graph.
-    std::vector<std::vector<bool>> adjacencyList; // Adjacency list representing edges.
-    std::vector<size_t> rootNodes; // Stores IDs of all root nodes.
-    std::vector<std::vector<std::unordered_map<std::string, MiniBatch>>> batchData; // Each node's MiniBatch data for each batch.
-
-    /**
-     * @brief Performs a depth-first search to check if a cycle exists in the graph.
-     *
-     * @param current The ID of the current node.
-     * @param visited A vector of booleans indicating whether a node has been visited.
-     * @param recStack A vector of booleans indicating whether a node is in the recursion stack.
-     * @return True if a cycle is found, false otherwise.
-     */
-    bool dfs(size_t current, std::vector<bool>& visited, std::vector<bool>& recStack) {
-        if (!visited[current]) {
-            visited[current] = true;
-            recStack[current] = true;
-
-            for (size_t i = 0; i < nodes.size(); ++i) {
-                if (adjacencyList[current][i]) {
-                    if (!visited[i] && dfs(i, visited, recStack)) {
-                        return true; // find a cycle
-                    } else if (recStack[i]) {
-                        return true; // find a cycle
-                    }
-                }
-            }
-        }
-        recStack[current] = false; // remove the node from the recursion stack
-        return false; // no cycle found
-    }
-
-    /**
-     * @brief Checks if the input and output fields of two nodes match.
-     * 
-     * @param from The ID of the source node.
-     * @param to The ID of the destination node.
-     * @return True if the fields match, false otherwise.
-     */
-    bool matchingIO(size_t from, size_t to) {
-        auto& fromOutputs = nodes[from].getOutputs();
-        auto& toInputs = nodes[to].getInputs();
-
-        for (const auto& output : fromOutputs) {
-            if (toInputs.find(output.first) != toInputs.end()) {
-                return true; // found a matching field
-            }
-        }
-        return false; // no matching field found
-    }
-    
-    /**
-     * @brief Updates the list of root nodes.
-     */
-    void updateRoots() {
-        rootNodes.clear();
-        for (size_t i = 0; i < nodes.size(); ++i) {
-            if (isRoot(i)) {
-                rootNodes.push_back(i);
-            }
-        }
-    }
-
-};
\ No newline at end of file
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/1/2
+
+/**
+ * @file graph.h
+ *
+ * @brief Represents a computational graph capable of processing data through interconnected nodes.
+ *
+ * The Graph class manages a collection of interconnected GraphNodes, forming a directed graph.
+ * It supports operations like adding nodes, creating edges, and executing computations across the graph.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "dag_config.h"
+#include "graph_node.h"
+#include "mini_batch.h"
+#include "memory_planner.h"
+
+/**
+ * @brief Partition of the nodes into clusters executed as single tasks, see Graph::coarsen().
+ */
+struct TaskClusters {
+    std::vector<size_t> clusterOf; ///< Cluster of each node, indexed by node ID.
+    std::vector<std::vector<size_t>> members; ///< Nodes of each cluster in topological order, the head first.
+
+    /**
+     * @brief Checks if a node starts its cluster.
+     *
+     * Every other member of a cluster only has predecessors inside the cluster, so the cluster is
+     * ready as soon as its head is.
+     *
+     * @param nodeId The ID of the node.
+     * @return True if the node is the head of its cluster, or if there are no clusters.
+     */
+    bool isHead(size_t nodeId) const {
+        return clusterOf.empty() || members[clusterOf[nodeId]].front() == nodeId;
+    }
+};
+
+class Graph {
+public:
+    /**
+     * @brief Default constructor for Graph.
+     */
+    Graph() : batchData(0) {} // initialize batch size to be 0
+    
+    /**
+     * @brief Adds a new node to the graph.
+     *
+     * @param node The GraphNode to be added.
+     * @return The ID (index) of the newly added node.
+     */
+    size_t addNode(GraphNode node);
+
+    /**
+     * @brief Adds an edge from one node to another.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     * @return True if the edge is added successfully, false otherwise.
+     */
+    bool addEdge(size_t from, size_t to);
+
+    /**
+     * @brief Connects an output port of one node to an input port of another.
+     *
+     * Only the connected field is passed along the edge, and it may be renamed. Once an edge between
+     * two nodes has an explicit port connection, the fields with matching names are no longer passed
+     * implicitly; call this once per field to pass several.
+     *
+     * @param from The ID of the source node.
+     * @param outPort The name of the output field of the source node.
+     * @param to The ID of the destination node.
+     * @param inPort The name of the input field of the destination node.
+     * @return True if the connection is added successfully, false otherwise.
+     */
+    bool addEdge(size_t from, const std::string& outPort, size_t to, const std::string& inPort);
+
+    /**
+     * @brief Adds an edge that only orders two nodes, without passing any field.
+     *
+     * The destination runs after the source but receives none of its outputs. Like any edge, it makes
+     * the destination a non-root node. Adding a data edge between the same nodes later turns it into
+     * a data edge.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     * @return True if the nodes are ordered by an edge, false if the edge would create a cycle.
+     */
+    bool addOrderingEdge(size_t from, size_t to);
+
+    /**
+     * @brief Removes the ordering edges implied by longer paths, e.g. A->C when A->B->C exists.
+     *
+     * Reachability is computed with one bitset per node in reverse topological order, visiting the
+     * successors of each node in topological order, so an edge is redundant exactly when its
+     * destination is already reachable through an earlier successor. Edges that pass fields are kept
+     * even when redundant, since their destination consumes them. The graph is compiled again if any
+     * edge is removed.
+     *
+     * @return The number of edges removed.
+     * @throws std::logic_error If the graph is not compiled.
+     */
+    size_t reduceTransitiveEdges();
+
+    /**
+     * @brief Gets the port connections of an edge.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     * @return The explicit connections of the edge, or one connection per field name shared by the
+     *         outputs of the source and the inputs of the destination if it has none.
+     */
+    std::vector<PortEdge> getEdgePorts(size_t from, size_t to) const;
+
+    /**
+     * @brief Retrieves a reference to a node by its ID.
+     *
+     * @param index The ID of the node.
+     * @return A reference to the requested node.
+     */
+    GraphNode& getNode(size_t index) {
+        return nodes.at(index);
+    }
+
+    /**
+     * @brief Retrieves a const reference to a node by its ID.
+     *
+     * @param index The ID of the node.
+     * @return A const reference to the requested node.
+     */
+    const GraphNode& getNode(size_t index) const {
+        return nodes.at(index);
+    }
+
+    /**
+     * @brief Returns the number of nodes in the graph.
+     *
+     * @return The number of nodes.
+     */
+    size_t size() const {
+        return nodes.size();
+    }
+
+    /**
+     * @brief Checks if an edge exists between two nodes.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     * @return True if the edge exists, false otherwise.
+     */
+    bool edgeExists(size_t from, size_t to) const {
+        return from < nodes.size() && to < nodes.size()
+            && std::binary_search(adjacencyList[from].begin(), adjacencyList[from].end(), to);
+    }
+
+    /**
+     * @brief Checks if adding an edge would create a cycle in the graph.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     * @return True if adding the edge creates a cycle, false otherwise.
+     */
+    bool createsCycle(size_t from, size_t to);
+
+    /**
+     * @brief Checks if the graph has any cycles.
+     *
+     * @return True if the graph contains cycles, false otherwise.
+     */
+    bool hasCycle();
+
+    /**
+     * @brief Prints the structure of the graph.
+     */
+    void printGraph();
+
+    /**
+     * @brief Prints the IDs of all root nodes in the graph.
+     */
+    void printRoots();
+
+    /**
+     * @brief Checks if a node is ready for processing, based on the availability of input data.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch to check.
+     * @return True if the node is ready, false otherwise.
+     */
+    bool isReady(size_t nodeId, size_t batchId);
+    
+    /**
+     * @brief Retrieves a specific MiniBatch for a node.
+     *
+     * @param nodeId The ID of the node.
+     * @param batchId The ID of the batch.
+     * @param fieldName The name of the field.
+     * @return A reference to the requested MiniBatch.
+     */
+    MiniBatch& getMiniBatch(size_t nodeId, size_t batchId, const std::string& fieldName) {
+        return batchData[nodeId][batchId][fieldName];
+    }
+
+    /**
+     * @brief Retrieves all MiniBatches for a node.
+     *
+     * @param nodeId The ID of the node.
+     * @return A reference to the vector of MiniBatch maps for the node.
+     */
+    std::vector<std::unordered_map<std::string, MiniBatch>>& getNodeMiniBatches(size_t nodeId) {
+        if (nodeId >= batchData.size()) {
+            throw std::out_of_range("Node ID out of range.");
+        }
+
+        return batchData[nodeId];
+    }
+
+    /**
+     * @brief Initializes the MiniBatch structures for all nodes.
+     *
+     * @param numBatches The number of batches to initialize for each node.
+     */
+    void initMiniBatches(size_t numBatches);
+
+    /**
+     * @brief Retrieves a list of all root nodes in the graph.
+     *
+     * @return A vector containing the IDs of all root nodes.
+     */
+    const std::vector<size_t> getRootNodes() const {
+        return rootNodes;
+    }
+
+    /**
+     * @brief Checks if a node is a root node.
+     * 
+     * @param nodeIndex The index of the node to check.
+     * @return True if the node is a root node, false otherwise.
+     */
+    bool isRoot(size_t nodeIndex);
+
+    /**
+     * @brief Checks the fields of the whole graph.
+     *
+     * Reports every field whose declared type differs between an output and the input it feeds, and
+     * every required input of a non-root node that none of its predecessors produces.
+     *
+     * @return A description of each problem found, empty if the graph is valid.
+     */
+    std::vector<std::string> validate() const;
+
+    /**
+     * @brief Compiles the graph for execution.
+     *
+     * Validates the graph, then computes a topological order of the nodes together with the successor
+     * and predecessor lists of every node. Adding a node or an edge invalidates the compiled state.
+     *
+     * @throws std::logic_error If the graph contains a cycle or validate() reports a problem.
+     */
+    void compile();
+
+    /**
+     * @brief Enables reuse of MiniBatch buffers across fields whose lifetimes don't overlap.
+     *
+     * When enabled, compile() assigns a physical buffer to every MiniBatch and the executor hands the
+     * storage of intermediate MiniBatches back once they are consumed, so only the outputs nobody
+     * consumes keep their data after the run.
+     *
+     * @param enable True to enable buffer reuse, false to keep every MiniBatch.
+     */
+    void setBufferReuse(bool enable) {
+        bufferReuse = enable;
+        compiled = false;
+    }
+
+    /**
+     * @brief Checks if buffer reuse is enabled.
+     *
+     * @return True if buffer reuse is enabled, false otherwise.
+     */
+    bool isBufferReuseEnabled() const {
+        return bufferReuse;
+    }
+
+    /**
+     * @brief Retrieves the buffer assignment computed by compile().
+     *
+     * @return The buffer assignment, empty if buffer reuse is disabled.
+     */
+    const BufferAssignment& getBufferAssignment() const {
+        requireCompiled();
+        return bufferAssignment;
+    }
+
+    /**
+     * @brief Checks if the graph has been compiled since its last modification.
+     *
+     * @return True if the graph is compiled, false otherwise.
+     */
+    bool isCompiled() const {
+        return compiled;
+    }
+
+    /**
+     * @brief Retrieves the topological order computed by compile().
+     *
+     * @return The node IDs in topological order.
+     */
+    const std::vector<size_t>& getTopologicalOrder() const {
+        requireCompiled();
+        return topologicalOrder;
+    }
+
+    /**
+     * @brief Retrieves the direct successors of a node.
+     *
+     * @param nodeId The ID of the node.
+     * @return The IDs of the nodes the node has an edge to.
+     */
+    const std::vector<size_t>& getSuccessors(size_t nodeId) const {
+        requireCompiled();
+        return successors.at(nodeId);
+    }
+
+    /**
+     * @brief Retrieves the direct predecessors of a node.
+     *
+     * @param nodeId The ID of the node.
+     * @return The IDs of the nodes having an edge to the node.
+     */
+    const std::vector<size_t>& getPredecessors(size_t nodeId) const {
+        requireCompiled();
+        return predecessors.at(nodeId);
+    }
+
+    /**
+     * @brief Retrieves the port connections leaving a node, computed by compile().
+     *
+     * @param nodeId The ID of the node.
+     * @return The connections of every edge from the node, grouped by destination.
+     */
+    const std::vector<PortEdge>& getConnections(size_t nodeId) const {
+        requireCompiled();
+        return connections.at(nodeId);
+    }
+
+    /**
+     * @brief Estimates the peak of live MiniBatch bytes when running the graph in topological order,
+     *        one batch after another.
+     *
+     * @param fieldSizes Bytes per element of each field, fields not listed count as one DataContainer.
+     * @param batchSizes Number of elements of each input batch.
+     * @return The estimate of the schedule.
+     */
+    MemoryEstimate estimatePeakMemory(const FieldSizes& fieldSizes, const std::vector<size_t>& batchSizes) const;
+
+    /**
+     * @brief Estimates the peak of live MiniBatch bytes of a given schedule.
+     *
+     * @param fieldSizes Bytes per element of each field, fields not listed count as one DataContainer.
+     * @param batchSizes Number of elements of each input batch.
+     * @param schedule The (nodeId, batchId) tasks in execution order.
+     * @return The estimate of the schedule.
+     */
+    MemoryEstimate estimatePeakMemory(const FieldSizes& fieldSizes, const std::vector<size_t>& batchSizes,
+                                      const std::vector<ScheduleStep>& schedule) const;
+
+    /**
+     * @brief Plans a task order that keeps the peak of live MiniBatch bytes low.
+     *
+     * @param fieldSizes Bytes per element of each field, fields not listed count as one DataContainer.
+     * @param batchSizes Number of elements of each input batch.
+     * @return The planned schedule and its estimate.
+     */
+    MemoryPlan planMemory(const FieldSizes& fieldSizes, const std::vector<size_t>& batchSizes) const;
+
+    /**
+     * @brief Groups connected cheap nodes into clusters that run as one task.
+     *
+     * Walking the topological order, a cheap node joins the cluster holding all its predecessors as
+     * long as the cluster stays within the grain; every other node starts a new cluster. Since only a
+     * cluster's head has predecessors outside of it, the clusters form a DAG and run without extra
+     * synchronization, while fan-outs of expensive work keep their parallelism.
+     *
+     * @param costs Expected seconds per task of each node, indexed by node ID.
+     * @param grainSeconds Largest total cost of a cluster; nodes at least this expensive stay alone.
+     * @return The clusters.
+     */
+    TaskClusters coarsen(const std::vector<double>& costs, double grainSeconds) const;
+
+private:
+    std::vector<GraphNode> nodes; // Stores all nodes in the graph.
+    std::vector<std::vector<size_t>> adjacencyList; // Sorted destinations of the edges leaving each node.
+    std::vector<size_t> inDegrees; // Number of edges entering each node.
+    std::vector<size_t> rootNodes; // Stores IDs of all root nodes.
+    std::vector<std::vector<std::unordered_map<std::string, MiniBatch>>> batchData; // Each node's MiniBatch data for each batch.
+    bool compiled = false; // Whether the compiled state below is up to date.
+    std::vector<size_t> topologicalOrder; // Node IDs in topological order.
+    std::vector<std::vector<size_t>> successors; // Successor list of each node.
+    std::vector<std::vector<size_t>> predecessors; // Predecessor list of each node.
+    std::map<std::pair<size_t, size_t>, std::vector<PortEdge>> explicitPorts; // Port connections added per edge.
+    std::vector<std::vector<PortEdge>> connections; // Port connections leaving each node.
+    bool bufferReuse = false; // Whether MiniBatches share physical buffers.
+    BufferAssignment bufferAssignment; // Physical buffer of each MiniBatch.
+
+    /**
+     * @brief Throws if the graph has been modified since the last call to compile().
+     */
+    void requireCompiled() const {
+        if (!compiled) {
+            throw std::logic_error("Graph is not compiled.");
+        }
+    }
+
+    /**
+     * @brief Adds an edge to the adjacency list if it is missing, and updates the root nodes.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     */
+    void insertEdge(size_t from, size_t to);
+
+    /**
+     * @brief Removes an edge from the adjacency list, and updates the root nodes.
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     */
+    void eraseEdge(size_t from, size_t to);
+
+    /**
+     * @brief Checks if the input and output fields of two nodes match.
+     * 
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     * @return True if the fields match, false otherwise.
+     */
+    bool matchingIO(size_t from, size_t to);
+    
+    /**
+     * @brief Updates the list of root nodes.
+     */
+    void updateRoots();
+
+    friend class GraphBuilder;
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "graph.cpp"
+#endif
@@ -0,0 +1,265 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/24
+
+/**
+ * @file graph_builder.cpp
+ *
+ * @brief Implements the GraphBuilder class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by graph_builder.h otherwise.
+ */
+
+#include "graph_builder.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+DAG_INLINE size_t GraphBuilder::addNodes(std::vector<GraphNode> nodes) {
+    size_t first = m_nodes.size();
+    m_nodes.insert(m_nodes.end(), std::make_move_iterator(nodes.begin()), std::make_move_iterator(nodes.end()));
+    return first;
+}
+
+DAG_INLINE void GraphBuilder::addEdges(const std::vector<std::pair<size_t, size_t>>& edges) {
+    m_edges.reserve(m_edges.size() + edges.size());
+    for (const auto& edge : edges) {
+        addEdge(edge.first, edge.second);
+    }
+}
+
+DAG_INLINE std::vector<size_t> GraphBuilder::groupBySource(std::vector<size_t>& offsets) const {
+    // counting sort on the source node
+    offsets.assign(m_nodes.size() + 1, 0);
+    for (const auto& edge : m_edges) {
+        if (inRange(edge)) {
+            offsets[edge.from + 1]++;
+        }
+    }
+    for (size_t nodeId = 0; nodeId < m_nodes.size(); ++nodeId) {
+        offsets[nodeId + 1] += offsets[nodeId];
+    }
+    std::vector<size_t> order(offsets.back());
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < m_edges.size(); ++i) {
+        if (inRange(m_edges[i])) {
+            order[next[m_edges[i].from]++] = i;
+        }
+    }
+    return order;
+}
+
+DAG_INLINE std::vector<std::vector<size_t>> GraphBuilder::findCycles() const {
+    const size_t numNodes = m_nodes.size();
+    std::vector<size_t> offsets;
+    std::vector<size_t> order = groupBySource(offsets);
+    auto destination = [&](size_t k) { return m_edges[order[k]].to; };
+
+    // a topological sort settles the common case of an acyclic graph
+    std::vector<size_t> inDegree(numNodes, 0);
+    for (size_t k = 0; k < order.size(); ++k) {
+        inDegree[destination(k)]++;
+    }
+    std::vector<size_t> ready;
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        if (inDegree[nodeId] == 0) {
+            ready.push_back(nodeId);
+        }
+    }
+    size_t sorted = 0;
+    while (!ready.empty()) {
+        size_t nodeId = ready.back();
+        ready.pop_back();
+        ++sorted;
+        for (size_t k = offsets[nodeId]; k < offsets[nodeId + 1]; ++k) {
+            if (--inDegree[destination(k)] == 0) {
+                ready.push_back(destination(k));
+            }
+        }
+    }
+    std::vector<std::vector<size_t>> cycles;
+    if (sorted == numNodes) {
+        return cycles;
+    }
+
+    // Tarjan's strongly connected components over the nodes left, without recursion
+    const size_t unvisited = static_cast<size_t>(-1);
+    std::vector<size_t> index(numNodes, unvisited);
+    std::vector<size_t> lowLink(numNodes, 0);
+    std::vector<size_t> component(numNodes, unvisited);
+    std::vector<bool> onStack(numNodes, false);
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, size_t>> calls; // node and next edge to follow
+    std::vector<std::vector<size_t>> components;
+    size_t nextIndex = 0;
+    for (size_t start = 0; start < numNodes; ++start) {
+        if (inDegree[start] == 0 || index[start] != unvisited) {
+            continue;
+        }
+        calls.push_back({start, offsets[start]});
+        index[start] = lowLink[start] = nextIndex++;
+        stack.push_back(start);
+        onStack[start] = true;
+        while (!calls.empty()) {
+            size_t nodeId = calls.back().first;
+            size_t& k = calls.back().second;
+            if (k < offsets[nodeId + 1]) {
+                size_t next = destination(k++);
+                if (index[next] == unvisited) {
+                    index[next] = lowLink[next] = nextIndex++;
+                    stack.push_back(next);
+                    onStack[next] = true;
+                    calls.push_back({next, offsets[next]});
+                } else if (onStack[next]) {
+                    lowLink[nodeId] = std::min(lowLink[nodeId], index[next]);
+                }
+                continue;
+            }
+            calls.pop_back();
+            if (!calls.empty()) {
+                size_t parent = calls.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[nodeId]);
+            }
+            if (lowLink[nodeId] == index[nodeId]) {
+                std::vector<size_t> members;
+                size_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    component[member] = components.size();
+                    members.push_back(member);
+                } while (member != nodeId);
+                components.push_back(std::move(members));
+            }
+        }
+    }
+
+    // one shortest cycle through the smallest node of every component holding a cycle
+    std::vector<size_t> parent(numNodes, unvisited);
+    for (size_t c = 0; c < components.size(); ++c) {
+        size_t start = *std::min_element(components[c].begin(), components[c].end());
+        std::vector<size_t> queue(1, start);
+        size_t last = unvisited;
+        for (size_t head = 0; head < queue.size() && last == unvisited; ++head) {
+            size_t nodeId = queue[head];
+            for (size_t k = offsets[nodeId]; k < offsets[nodeId + 1]; ++k) {
+                size_t next = destination(k);
+                if (next == start) {
+                    last = nodeId;
+                    break;
+                }
+                if (component[next] == c && parent[next] == unvisited) {
+                    parent[next] = nodeId;
+                    queue.push_back(next);
+                }
+            }
+        }
+        if (last == unvisited) {
+            continue; // a single node without a self-loop
+        }
+        std::vector<size_t> cycle;
+        for (size_t nodeId = last; nodeId != start; nodeId = parent[nodeId]) {
+            cycle.push_back(nodeId);
+        }
+        cycle.push_back(start);
+        std::reverse(cycle.begin(), cycle.end());
+        cycle.push_back(start);
+        cycles.push_back(std::move(cycle));
+    }
+    return cycles;
+}
+
+DAG_INLINE std::vector<std::string> GraphBuilder::validate() const {
+    std::vector<std::string> problems;
+    for (const auto& edge : m_edges) {
+        std::string name = "Edge " + std::to_string(edge.from) + " -> " + std::to_string(edge.to);
+        if (!inRange(edge)) {
+            problems.push_back(name + " refers to a node out of range.");
+            continue;
+        }
+        const auto& outputs = m_nodes[edge.from].getOutputs();
+        const auto& inputs = m_nodes[edge.to].getInputs();
+        if (edge.kind == EdgeKind::Matching) {
+            bool matching = std::any_of(outputs.begin(), outputs.end(), [&inputs](const auto& output) {
+                return inputs.find(output.first) != inputs.end();
+            });
+            if (!matching) {
+                problems.push_back(name + " passes no field.");
+            }
+        } else if (edge.kind == EdgeKind::Port) {
+            if (outputs.find(edge.outPort) == outputs.end()) {
+                problems.push_back(name + ": '" + edge.outPort + "' is not an output of node "
+                                   + std::to_string(edge.from) + ".");
+            }
+            if (inputs.find(edge.inPort) == inputs.end()) {
+                problems.push_back(name + ": '" + edge.inPort + "' is not an input of node "
+                                   + std::to_string(edge.to) + ".");
+            }
+        }
+    }
+    for (const auto& cycle : findCycles()) {
+        std::string message = "Cycle";
+        for (size_t i = 0; i < cycle.size(); ++i) {
+            message += (i == 0 ? " " : " -> ") + std::to_string(cycle[i]);
+        }
+        problems.push_back(message + ".");
+    }
+    return problems;
+}
+
+DAG_INLINE Graph GraphBuilder::build() {
+    std::vector<std::string> problems = validate();
+    if (!problems.empty()) {
+        std::string message = "Invalid graph:";
+        for (const auto& problem : problems) {
+            message += " " + problem;
+        }
+        throw std::logic_error(message);
+    }
+
+    const size_t numNodes = m_nodes.size();
+    std::vector<size_t> offsets;
+    std::vector<size_t> order = groupBySource(offsets);
+    Graph graph;
+    graph.nodes = std::move(m_nodes);
+    graph.adjacencyList.assign(numNodes, std::vector<size_t>());
+    graph.inDegrees.assign(numNodes, 0);
+    for (size_t from = 0; from < numNodes; ++from) {
+        auto begin = order.begin() + static_cast<std::ptrdiff_t>(offsets[from]);
+        auto end = order.begin() + static_cast<std::ptrdiff_t>(offsets[from + 1]);
+        std::stable_sort(begin, end, [this](size_t a, size_t b) { return m_edges[a].to < m_edges[b].to; });
+
+        // edges between the same nodes merge like repeated Graph::addEdge calls: ports replace the
+        // matching fields, which replace a mere ordering
+        for (auto group = begin; group != end;) {
+            size_t to = m_edges[*group].to;
+            auto groupEnd = std::find_if(group, end, [this, to](size_t i) { return m_edges[i].to != to; });
+            std::vector<PortEdge> ports;
+            bool matching = false;
+            for (auto it = group; it != groupEnd; ++it) {
+                const PendingEdge& edge = m_edges[*it];
+                matching = matching || edge.kind == EdgeKind::Matching;
+                bool known = std::any_of(ports.begin(), ports.end(), [&edge](const PortEdge& port) {
+                    return port.outPort == edge.outPort && port.inPort == edge.inPort;
+                });
+                if (edge.kind == EdgeKind::Port && !known) {
+                    ports.push_back(PortEdge{from, edge.outPort, to, edge.inPort});
+                }
+            }
+            if (!ports.empty() || !matching) {
+                graph.explicitPorts.emplace_hint(graph.explicitPorts.end(), std::make_pair(from, to), std::move(ports));
+            }
+            graph.adjacencyList[from].push_back(to);
+            graph.inDegrees[to]++;
+            group = groupEnd;
+        }
+    }
+    graph.updateRoots();
+
+    m_nodes.clear();
+    m_edges.clear();
+    return graph;
+}
@@ -0,0 +1,177 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/24
+
+/**
+ * @file graph_builder.h
+ *
+ * @brief Builds large graphs from nodes and edges given in bulk.
+ *
+ * Graph::addEdge checks every edge for cycles and matching fields as soon as it is added, which costs a
+ * traversal of the graph per edge. The GraphBuilder only records the nodes and edges, and validates them
+ * all at once in build(): one counting sort groups the edges, one topological sort finds whether there
+ * are cycles, and only then are the strongly connected components searched, so that every cycle is
+ * reported in the same error.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "dag_config.h"
+#include "graph.h"
+
+class GraphBuilder {
+public:
+    /**
+     * @brief Reserves storage for the nodes and edges to come.
+     *
+     * @param numNodes Expected number of nodes.
+     * @param numEdges Expected number of edges.
+     */
+    void reserve(size_t numNodes, size_t numEdges) {
+        m_nodes.reserve(numNodes);
+        m_edges.reserve(numEdges);
+    }
+
+    /**
+     * @brief Adds a node.
+     *
+     * @param node The GraphNode to be added.
+     * @return The ID the node will have in the built graph.
+     */
+    size_t addNode(GraphNode node) {
+        m_nodes.push_back(std::move(node));
+        return m_nodes.size() - 1;
+    }
+
+    /**
+     * @brief Adds nodes with consecutive IDs.
+     *
+     * @param nodes The GraphNodes to be added.
+     * @return The ID of the first node added.
+     */
+    size_t addNodes(std::vector<GraphNode> nodes);
+
+    /**
+     * @brief Adds an edge passing the fields with matching names, see Graph::addEdge(size_t, size_t).
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     */
+    void addEdge(size_t from, size_t to) {
+        m_edges.push_back(PendingEdge{from, to, EdgeKind::Matching, std::string(), std::string()});
+    }
+
+    /**
+     * @brief Connects an output port to an input port, see Graph::addEdge(size_t, const std::string&,
+     *        size_t, const std::string&).
+     *
+     * @param from The ID of the source node.
+     * @param outPort The name of the output field of the source node.
+     * @param to The ID of the destination node.
+     * @param inPort The name of the input field of the destination node.
+     */
+    void addEdge(size_t from, const std::string& outPort, size_t to, const std::string& inPort) {
+        m_edges.push_back(PendingEdge{from, to, EdgeKind::Port, outPort, inPort});
+    }
+
+    /**
+     * @brief Adds an edge that only orders two nodes, see Graph::addOrderingEdge().
+     *
+     * @param from The ID of the source node.
+     * @param to The ID of the destination node.
+     */
+    void addOrderingEdge(size_t from, size_t to) {
+        m_edges.push_back(PendingEdge{from, to, EdgeKind::Ordering, std::string(), std::string()});
+    }
+
+    /**
+     * @brief Adds edges passing the fields with matching names.
+     *
+     * @param edges The (from, to) pairs of node IDs.
+     */
+    void addEdges(const std::vector<std::pair<size_t, size_t>>& edges);
+
+    /**
+     * @brief Returns the number of nodes added so far.
+     *
+     * @return The number of nodes.
+     */
+    size_t size() const {
+        return m_nodes.size();
+    }
+
+    /**
+     * @brief Finds one cycle in every strongly connected component of the graph built so far.
+     *
+     * Edges with a node ID out of range are ignored.
+     *
+     * @return Each cycle as the node IDs along it, the first node repeated at the end.
+     */
+    std::vector<std::vector<size_t>> findCycles() const;
+
+    /**
+     * @brief Checks all the recorded edges at once.
+     *
+     * @return One message per node ID out of range, per edge without any field to pass, per port that
+     *         isn't a field of its node and per cycle; empty if the graph can be built.
+     */
+    std::vector<std::string> validate() const;
+
+    /**
+     * @brief Builds the graph and leaves the builder empty.
+     *
+     * The graph isn't compiled yet: the field types and unconnected inputs are checked by
+     * Graph::compile() as usual.
+     *
+     * @return The graph.
+     * @throws std::logic_error If validate() finds any problem, listing all of them.
+     */
+    Graph build();
+
+private:
+    /**
+     * @brief How an edge passes fields.
+     */
+    enum class EdgeKind {
+        Matching, ///< The fields with matching names.
+        Port, ///< One explicit port connection.
+        Ordering ///< No field.
+    };
+
+    /**
+     * @brief An edge recorded by the builder.
+     */
+    struct PendingEdge {
+        size_t from; ///< The ID of the source node.
+        size_t to; ///< The ID of the destination node.
+        EdgeKind kind; ///< How the edge passes fields.
+        std::string outPort; ///< The output port of a port connection.
+        std::string inPort; ///< The input port of a port connection.
+    };
+
+    std::vector<GraphNode> m_nodes; // Nodes in ID order
+    std::vector<PendingEdge> m_edges; // Edges in insertion order
+
+    /**
+     * @brief Checks that both ends of an edge are nodes of the graph.
+     */
+    bool inRange(const PendingEdge& edge) const {
+        return edge.from < m_nodes.size() && edge.to < m_nodes.size();
+    }
+
+    /**
+     * @brief Groups the edges with valid node IDs by source node, keeping the insertion order.
+     *
+     * @param offsets Receives the start of the edges of each node, plus the end of the last one.
+     * @return The indices into m_edges, sorted by source node.
+     */
+    std::vector<size_t> groupBySource(std::vector<size_t>& offsets) const;
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "graph_builder.cpp"
+#endif
@@ -0,0 +1,162 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/3/25
+
+/**
+ * @file graph_export.cpp
+ *
+ * @brief Implements the GraphExporter class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by graph_export.h otherwise.
+ */
+
+#include "graph_export.h"
+
+#include <sstream>
+
+DAG_INLINE GraphExporter::GraphExporter(const Graph& graph, const ExecutorStats& stats)
+    : m_graph(graph), m_stats(stats), m_critical(graph.size(), false) {
+    for (size_t nodeId : criticalPath()) {
+        m_critical[nodeId] = true;
+    }
+}
+
+DAG_INLINE std::vector<size_t> GraphExporter::criticalPath() const {
+    const size_t none = m_graph.size();
+    std::vector<double> finish(m_graph.size(), 0.0);
+    std::vector<size_t> parent(m_graph.size(), none);
+    size_t last = none;
+    for (size_t nodeId : m_graph.getTopologicalOrder()) {
+        for (size_t predecessor : m_graph.getPredecessors(nodeId)) {
+            if (parent[nodeId] == none || finish[predecessor] > finish[parent[nodeId]]) {
+                parent[nodeId] = predecessor;
+            }
+        }
+        finish[nodeId] = nodeStats(nodeId).seconds + (parent[nodeId] == none ? 0.0 : finish[parent[nodeId]]);
+        if (last == none || finish[nodeId] > finish[last]) {
+            last = nodeId;
+        }
+    }
+
+    std::vector<size_t> path;
+    for (size_t nodeId = last; nodeId != none; nodeId = parent[nodeId]) {
+        path.insert(path.begin(), nodeId);
+    }
+    return path;
+}
+
+DAG_INLINE void GraphExporter::writeDot(std::ostream& out) const {
+    out << "digraph DAG {\n";
+    out << "  rankdir=LR;\n";
+    out << "  node [shape=box];\n";
+    for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+        const NodeStats& stats = nodeStats(nodeId);
+        out << "  n" << nodeId << " [label=\"Node " << nodeId;
+        for (const auto& output : m_graph.getNode(nodeId).getOutputs()) {
+            out << "\\n" << escape(output.first);
+        }
+        out << "\\n" << stats.seconds * 1e3 << " ms, " << stats.invocations << " runs"
+            << "\\n" << stats.elementsPerSecond() << " elem/s";
+        if (m_stats.hardwareCounters) {
+            out << "\\nIPC " << stats.instructionsPerCycle() << ", " << stats.llcMissesPerElement() << " LLC misses/elem";
+        }
+        out << "\"";
+        if (m_critical[nodeId]) {
+            out << ", color=red, penwidth=2";
+        }
+        out << "];\n";
+    }
+    for (size_t from = 0; from < m_graph.size(); ++from) {
+        for (size_t to : m_graph.getSuccessors(from)) {
+            out << "  n" << from << " -> n" << to << " [label=\"" << edgeBytes(from, to) << " B\"";
+            if (m_critical[from] && m_critical[to]) {
+                out << ", color=red, penwidth=2";
+            }
+            out << "];\n";
+        }
+    }
+    out << "}\n";
+}
+
+DAG_INLINE void GraphExporter::writeJson(std::ostream& out) const {
+    out << "{\n  \"wallSeconds\": " << m_stats.wallSeconds << ",\n  \"pageSize\": " << m_stats.pageSize
+        << ",\n  \"hardwareCounters\": " << (m_stats.hardwareCounters ? "true" : "false")
+        << ",\n  \"nodes\": [";
+    for (size_t nodeId = 0; nodeId < m_graph.size(); ++nodeId) {
+        const GraphNode& node = m_graph.getNode(nodeId);
+        const NodeStats& stats = nodeStats(nodeId);
+        out << (nodeId == 0 ? "\n" : ",\n") << "    {\"id\": " << nodeId
+            << ", \"inputs\": " << fieldList(node.getInputs())
+            << ", \"outputs\": " << fieldList(node.getOutputs())
+            << ", \"invocations\": " << stats.invocations
+            << ", \"seconds\": " << stats.seconds
+            << ", \"elements\": " << stats.elements
+            << ", \"elementsPerSecond\": " << stats.elementsPerSecond()
+            << ", \"bytesIn\": " << stats.bytesIn
+            << ", \"bytesOut\": " << stats.bytesOut
+            << ", \"cycles\": " << stats.counters.cycles
+            << ", \"instructions\": " << stats.counters.instructions
+            << ", \"instructionsPerCycle\": " << stats.instructionsPerCycle()
+            << ", \"llcMissesPerElement\": " << stats.llcMissesPerElement()
+            << ", \"branchMissesPerElement\": " << stats.branchMissesPerElement()
+            << ", \"critical\": " << (m_critical[nodeId] ? "true" : "false") << "}";
+    }
+    out << "\n  ],\n  \"edges\": [";
+    bool first = true;
+    for (size_t from = 0; from < m_graph.size(); ++from) {
+        for (size_t to : m_graph.getSuccessors(from)) {
+            out << (first ? "\n" : ",\n") << "    {\"from\": " << from << ", \"to\": " << to
+                << ", \"bytes\": " << edgeBytes(from, to)
+                << ", \"critical\": " << (m_critical[from] && m_critical[to] ? "true" : "false") << "}";
+            first = false;
+        }
+    }
+    out << "\n  ],\n  \"criticalPath\": [";
+    std::vector<size_t> path = criticalPath();
+    for (size_t i = 0; i < path.size(); ++i) {
+        out << (i == 0 ? "" : ", ") << path[i];
+    }
+    out << "]\n}\n";
+}
+
+DAG_INLINE std::string GraphExporter::toDot() const {
+    std::ostringstream out;
+    writeDot(out);
+    return out.str();
+}
+
+DAG_INLINE std::string GraphExporter::toJson() const {
+    std::ostringstream out;
+    writeJson(out);
+    return out.str();
+}
+
+DAG_INLINE const NodeStats& GraphExporter::nodeStats(size_t nodeId) const {
+    static const NodeStats empty;
+    return nodeId < m_stats.nodes.size() ? m_stats.nodes[nodeId] : empty;
+}
+
+DAG_INLINE size_t GraphExporter::edgeBytes(size_t from, size_t to) const {
+    auto it = m_stats.edgeBytes.find({from, to});
+    return it == m_stats.edgeBytes.end() ? 0 : it->second;
+}
+
+DAG_INLINE std::string GraphExporter::escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+DAG_INLINE std::string GraphExporter::fieldList(const std::map<std::string, DataContainer>& fields) {
+    std::string list = "[";
+    for (const auto& field : fields) {
+        list += (list.size() == 1 ? "\"" : ", \"") + escape(field.first) + "\"";
+    }
+    return list + "]";
+}
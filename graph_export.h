@@ -0,0 +1,95 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/3/25
+
+/**
+ * @file graph_export.h
+ *
+ * @brief Exports a graph annotated with runtime statistics to DOT (Graphviz) and JSON.
+ *
+ * Every node is annotated with its measured execution time and throughput, every edge with the bytes
+ * copied along it, and the critical path (the chain of nodes with the largest total execution time)
+ * is highlighted.
+ */
+
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "dag_config.h"
+#include "graph.h"
+#include "executor_stats.h"
+
+class GraphExporter {
+public:
+    /**
+     * @brief Constructs an exporter for a compiled graph and the statistics of one of its runs.
+     *
+     * @param graph The compiled graph.
+     * @param stats The statistics collected by the Executor.
+     */
+    GraphExporter(const Graph& graph, const ExecutorStats& stats);
+
+    /**
+     * @brief Computes the critical path of the graph.
+     *
+     * @return The node IDs of the path with the largest total execution time, from root to sink.
+     */
+    std::vector<size_t> criticalPath() const;
+
+    /**
+     * @brief Writes the graph in DOT format.
+     *
+     * @param out The stream to write to.
+     */
+    void writeDot(std::ostream& out) const;
+
+    /**
+     * @brief Writes the graph in JSON format.
+     *
+     * @param out The stream to write to.
+     */
+    void writeJson(std::ostream& out) const;
+
+    /**
+     * @brief Returns the graph in DOT format.
+     */
+    std::string toDot() const;
+
+    /**
+     * @brief Returns the graph in JSON format.
+     */
+    std::string toJson() const;
+
+private:
+    const Graph& m_graph;
+    const ExecutorStats& m_stats;
+    std::vector<bool> m_critical; // Whether each node lies on the critical path
+
+    /**
+     * @brief Statistics of a node, empty if the run didn't reach it.
+     */
+    const NodeStats& nodeStats(size_t nodeId) const;
+
+    /**
+     * @brief Bytes copied along an edge, 0 if none were measured.
+     */
+    size_t edgeBytes(size_t from, size_t to) const;
+
+    /**
+     * @brief Escapes the quotes and backslashes of a name for DOT and JSON strings.
+     */
+    static std::string escape(const std::string& text);
+
+    /**
+     * @brief Formats the names of fields as a JSON array.
+     */
+    static std::string fieldList(const std::map<std::string, DataContainer>& fields);
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "graph_export.cpp"
+#endif
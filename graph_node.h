@@ -1,204 +1,419 @@
-// Copyright (C) 2024 Haochen Jiang
-//
-// Authors: Haochen Jiang
-// Date: 2024/1/2
-
-/**
- * @file graph_node.h
- *
- * @brief Represents a node within a computational graph capable of processing data.
- *
- * This class encapsulates a single node in a computational graph, where each node can execute
- * a specific computational task. It can process data on either CPU or GPU, depending on its configuration.
- */
-
-#pragma once
-
-#include <vector>
-#include <functional>
-#include <map>
-#include <string>
-#include "data_container.h"
-#include "mini_batch.h"
-
-enum class ComputeType { CPU, GPU };
-
-class GraphNode {
-public:
-    /**
-     * @brief Default constructor for GraphNode, setting its compute type.
-     * 
-     * @param type The compute type of the node (CPU or GPU).
-     */
-    GraphNode(ComputeType type) : computeType(type) {}
-
-    /**
-     * @brief Constructor allowing direct setting of the processing function.
-     * 
-     * @param type The compute type of the node (CPU or GPU).
-     * @param processFunc The processing function to be executed by this node.
-     */
-    GraphNode(ComputeType type, std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> processFunc)
-        : computeType(type) {
-        if (type == ComputeType::CPU) {
-            cpuProcess = processFunc;
-        } else {
-            gpuProcess = processFunc;
-        }
-    }
-
-    /**
-     * @brief Sets the CPU processing function.
-     * 
-     * @param cpuFunc The function to be used for CPU processing.
-     */
-    void setCPUProcess(std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> cpuFunc) {
-        cpuProcess = cpuFunc;
-    }
-
-    /**
-     * @brief Sets the GPU processing function.
-     * 
-     * @param gpuFunc The function to be used for GPU processing.
-     */
-    void setGPUProcess(std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> gpuFunc) {
-        gpuProcess = gpuFunc;
-    }
-
-    /**
-     * @brief Executes the node's processing function based on its compute type.
-     */
-    void execute() {
-        if (computeType == ComputeType::CPU && cpuProcess) {
-            cpuProcess(inputs, outputs);
-        } else if (computeType == ComputeType::GPU && gpuProcess) {
-            gpuProcess(inputs, outputs);
-        }
-    }
-
-    /**
-     * @brief Adds an input field and its associated data to the node.
-     * 
-     * @param name The name of the input field.
-     * @param value The data to be associated with the input field.
-     */
-    void addInput(const std::string& name, const DataContainer& value) {
-        inputs[name] = value;
-    }
-
-    /**
-     * @brief Adds an output field and its associated data to the node.
-     * 
-     * @param name The name of the output field.
-     * @param value The data to be associated with the output field.
-     */
-    void addOutput(const std::string& name, const DataContainer& value) {
-        outputs[name] = value;
-    }
-
-    /**
-     * @brief Sets the data for a specific input field.
-     * 
-     * @param name The name of the input field.
-     * @param value The data to be set for the input field.
-     */
-    void setInput(const std::string& name, const DataContainer& value) {
-        inputs[name] = value;
-    }
-
-    /**
-     * @brief Sets the data for a specific output field.
-     * 
-     * @param name The name of the output field.
-     * @param value The data to be set for the output field.
-     */
-    void setOutput(const std::string& name, const DataContainer& value) {
-        outputs[name] = value;
-    }
-
-    /**
-     * @brief Retrieves the data from a specific input field.
-     * 
-     * @param name The name of the input field.
-     * @return The data associated with the specified input field.
-     */
-    const DataContainer& getInput(const std::string& name) const {
-        return inputs.at(name);
-    }
-
-    /**
-     * @brief Retrieves the data from a specific output field.
-     * 
-     * @param name The name of the output field.
-     * @return The data associated with the specified output field.
-     */
-    const DataContainer& getOutput(const std::string& name) {
-        return outputs[name];
-    }
-
-    /**
-     * @brief Gets all the input fields and their associated data.
-     * 
-     * @return A map of input field names to their associated data.
-     */
-    const std::map<std::string, DataContainer>& getInputs() const {
-        return inputs;
-    }
-
-    /**
-     * @brief Gets all the output fields and their associated data.
-     * 
-     * @return A map of output field names to their associated data.
-     */
-    const std::map<std::string, DataContainer>& getOutputs() const {
-        return outputs;
-    }
-
-    const std::vector<MiniBatch>& getInputBatch() const {
-        return inputBatch;
-    }
-
-    const std::vector<MiniBatch>& getOutputBatch() const {
-        return outputBatch;
-    }
-
-    const MiniBatch& getOutputBatch(const std::string& name) const {
-        for (const auto& output : outputBatch) {
-            if (output.getName() == name) {
-                return output;
-            }
-        }
-    }
-
-    void setInputBatch(const std::vector<MiniBatch>& batch) {
-        inputBatch = batch;
-    }
-
-    void setOutputBatch(const std::vector<MiniBatch>& batch) {
-        outputBatch = batch;
-    }
-
-    ComputeType getComputeType() const {
-        return computeType;
-    }
-
-    void cleanUp() {
-        for (auto& input : inputs) {
-            input.second = DataContainer();
-        }
-        for (auto& output : outputs) {
-            output.second = DataContainer();
-        }
-        inputBatch.clear();
-        outputBatch.clear();
-    }
-
-private:
-    ComputeType computeType; ///< The compute type of the node (CPU or GPU).
-    std::map<std::string, DataContainer> inputs; ///< Map of input field names to data.
-    std::map<std::string, DataContainer> outputs; ///< Map of output field names to data.
-    std::vector<MiniBatch> inputBatch; ///< The input MiniBatch. (currently only for GPU processing)
-    std::vector<MiniBatch> outputBatch; ///< The output MiniBatch. (currently only for GPU processing)
-    std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> cpuProcess; ///< The CPU processing function.
-    std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> gpuProcess; ///< The GPU processing function.
-};
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/1/2
+
+/**
+ * @file graph_node.h
+ *
+ * @brief Represents a node within a computational graph capable of processing data.
+ *
+ * This class encapsulates a single node in a computational graph, where each node can execute
+ * a specific computational task. It can process data on either CPU or GPU, depending on its configuration.
+ */
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <stdexcept>
+#include <utility>
+#include "data_container.h"
+#include "mini_batch.h"
+
+enum class ComputeType { CPU, GPU };
+
+class Expression;
+
+/**
+ * @brief Connection of an output port of one node to an input port of another.
+ *
+ * The output MiniBatch of the source node is passed to the input MiniBatch of the destination node,
+ * which may have another name.
+ */
+struct PortEdge {
+    size_t from; ///< The ID of the source node.
+    std::string outPort; ///< The name of the output field of the source node.
+    size_t to; ///< The ID of the destination node.
+    std::string inPort; ///< The name of the input field of the destination node.
+};
+
+class GraphNode {
+public:
+    /**
+     * @brief Processing function over whole MiniBatches: input field names to the input MiniBatches, output
+     *        field names to the output MiniBatches it appends to.
+     */
+    using ColumnProcess = std::function<void(const std::map<std::string, const MiniBatch*>&, std::map<std::string, MiniBatch*>&)>;
+
+    /**
+     * @brief Default constructor for GraphNode, setting its compute type.
+     * 
+     * @param type The compute type of the node (CPU or GPU).
+     */
+    GraphNode(ComputeType type) : computeType(type) {}
+
+    /**
+     * @brief Constructor allowing direct setting of the processing function.
+     * 
+     * @param type The compute type of the node (CPU or GPU).
+     * @param processFunc The processing function to be executed by this node.
+     */
+    GraphNode(ComputeType type, std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> processFunc)
+        : computeType(type) {
+        if (type == ComputeType::CPU) {
+            cpuProcess = std::move(processFunc);
+        } else {
+            gpuProcess = std::move(processFunc);
+        }
+    }
+
+    /**
+     * @brief Sets the CPU processing function.
+     * 
+     * @param cpuFunc The function to be used for CPU processing.
+     */
+    void setCPUProcess(std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> cpuFunc) {
+        cpuProcess = cpuFunc;
+    }
+
+    /**
+     * @brief Sets the GPU processing function.
+     * 
+     * @param gpuFunc The function to be used for GPU processing.
+     */
+    void setGPUProcess(std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> gpuFunc) {
+        gpuProcess = gpuFunc;
+    }
+
+    /**
+     * @brief Sets a CPU processing function over whole MiniBatches.
+     *
+     * The executor then calls it once per batch instead of calling the element-wise CPU processing
+     * function once per element, so the node can process its inputs column at a time. In-place ports
+     * are ignored for such nodes.
+     *
+     * @param columnFunc The function to be used for CPU processing.
+     */
+    void setColumnProcess(ColumnProcess columnFunc) {
+        columnProcess = std::move(columnFunc);
+    }
+
+    /**
+     * @brief Checks if the node processes whole MiniBatches on the CPU.
+     *
+     * @return True if a column processing function is set.
+     */
+    bool hasColumnProcess() const {
+        return computeType == ComputeType::CPU && static_cast<bool>(columnProcess);
+    }
+
+    /**
+     * @brief Executes the column processing function.
+     *
+     * @param inputs The input MiniBatches.
+     * @param outputs The output MiniBatches.
+     */
+    void executeColumns(const std::map<std::string, const MiniBatch*>& inputs, std::map<std::string, MiniBatch*>& outputs) const {
+        columnProcess(inputs, outputs);
+    }
+
+    /**
+     * @brief Attaches the expression computed by the node, see makeExpressionNode().
+     *
+     * @param expr The expression.
+     */
+    void setExpression(std::shared_ptr<const Expression> expr) {
+        expression = std::move(expr);
+    }
+
+    /**
+     * @brief Gets the expression computed by the node.
+     *
+     * @return The expression, nullptr if the node isn't an expression node.
+     */
+    const std::shared_ptr<const Expression>& getExpression() const {
+        return expression;
+    }
+
+    /**
+     * @brief Declares how long one task of the node is expected to take, see Executor::setCoarsening().
+     *
+     * @param seconds Expected seconds per (node, batch) task, 0 if unknown.
+     */
+    void setCostEstimate(double seconds) {
+        costEstimate = seconds;
+    }
+
+    /**
+     * @brief Gets the declared cost of one task of the node.
+     *
+     * @return Expected seconds per task, 0 if unknown.
+     */
+    double getCostEstimate() const {
+        return costEstimate;
+    }
+
+    /**
+     * @brief Executes the node's processing function based on its compute type.
+     */
+    void execute() {
+        if (computeType == ComputeType::CPU && cpuProcess) {
+            cpuProcess(inputs, outputs);
+        } else if (computeType == ComputeType::GPU && gpuProcess) {
+            gpuProcess(inputs, outputs);
+        }
+    }
+
+    /**
+     * @brief Executes the node's processing function on caller-provided fields.
+     *
+     * Unlike execute(), the node's own input and output fields are left untouched, so the same node
+     * can be executed concurrently for different batches.
+     *
+     * @param inputs The input fields passed to the processing function.
+     * @param outputs The output fields filled by the processing function.
+     */
+    void execute(std::map<std::string, DataContainer>& inputs, std::map<std::string, DataContainer>& outputs) const {
+        if (computeType == ComputeType::CPU && cpuProcess) {
+            cpuProcess(inputs, outputs);
+        } else if (computeType == ComputeType::GPU && gpuProcess) {
+            gpuProcess(inputs, outputs);
+        }
+    }
+
+    /**
+     * @brief Adds an input field and its associated data to the node.
+     * 
+     * @param name The name of the input field.
+     * @param value The data to be associated with the input field.
+     */
+    void addInput(const std::string& name, const DataContainer& value) {
+        inputs[name] = value;
+    }
+
+    /**
+     * @brief Adds an output field and its associated data to the node.
+     * 
+     * @param name The name of the output field.
+     * @param value The data to be associated with the output field.
+     */
+    void addOutput(const std::string& name, const DataContainer& value) {
+        outputs[name] = value;
+    }
+
+    /**
+     * @brief Sets the data for a specific input field.
+     * 
+     * @param name The name of the input field.
+     * @param value The data to be set for the input field.
+     */
+    void setInput(const std::string& name, const DataContainer& value) {
+        inputs[name] = value;
+    }
+
+    /**
+     * @brief Sets the data for a specific output field.
+     * 
+     * @param name The name of the output field.
+     * @param value The data to be set for the output field.
+     */
+    void setOutput(const std::string& name, const DataContainer& value) {
+        outputs[name] = value;
+    }
+
+    /**
+     * @brief Retrieves the data from a specific input field.
+     * 
+     * @param name The name of the input field.
+     * @return The data associated with the specified input field.
+     */
+    const DataContainer& getInput(const std::string& name) const {
+        return inputs.at(name);
+    }
+
+    /**
+     * @brief Retrieves the data from a specific output field.
+     * 
+     * @param name The name of the output field.
+     * @return The data associated with the specified output field.
+     */
+    const DataContainer& getOutput(const std::string& name) {
+        return outputs[name];
+    }
+
+    /**
+     * @brief Gets all the input fields and their associated data.
+     * 
+     * @return A map of input field names to their associated data.
+     */
+    const std::map<std::string, DataContainer>& getInputs() const {
+        return inputs;
+    }
+
+    /**
+     * @brief Gets all the output fields and their associated data.
+     * 
+     * @return A map of output field names to their associated data.
+     */
+    const std::map<std::string, DataContainer>& getOutputs() const {
+        return outputs;
+    }
+
+    const std::vector<MiniBatch>& getInputBatch() const {
+        return inputBatch;
+    }
+
+    const std::vector<MiniBatch>& getOutputBatch() const {
+        return outputBatch;
+    }
+
+    const MiniBatch& getOutputBatch(const std::string& name) const {
+        for (const auto& output : outputBatch) {
+            if (output.getName() == name) {
+                return output;
+            }
+        }
+        throw std::out_of_range("Output batch not found: " + name);
+    }
+
+    void setInputBatch(const std::vector<MiniBatch>& batch) {
+        inputBatch = batch;
+    }
+
+    void setOutputBatch(const std::vector<MiniBatch>& batch) {
+        outputBatch = batch;
+    }
+
+    /**
+     * @brief Declares the type of the elements of an input field.
+     *
+     * Graph::validate() checks that the outputs feeding the input have the same type, and the executor
+     * checks the input MiniBatches of root nodes once before the run, so the processing function may
+     * rely on the type without checking every element.
+     *
+     * @param name The name of the input field.
+     * @param type The type of the elements, e.g. fieldTypeOf<double>().
+     */
+    void setInputType(const std::string& name, FieldType type) {
+        inputTypes[name] = type;
+    }
+
+    /**
+     * @brief Declares the type of the elements of an output field.
+     *
+     * @param name The name of the output field.
+     * @param type The type of the elements, e.g. fieldTypeOf<double>().
+     */
+    void setOutputType(const std::string& name, FieldType type) {
+        outputTypes[name] = type;
+    }
+
+    /**
+     * @brief Gets the declared type of an input field.
+     *
+     * @param name The name of the input field.
+     * @return The type of the elements, untypedField if not declared.
+     */
+    FieldType getInputType(const std::string& name) const {
+        auto it = inputTypes.find(name);
+        return it == inputTypes.end() ? untypedField : it->second;
+    }
+
+    /**
+     * @brief Gets the declared type of an output field.
+     *
+     * @param name The name of the output field.
+     * @return The type of the elements, untypedField if not declared.
+     */
+    FieldType getOutputType(const std::string& name) const {
+        auto it = outputTypes.find(name);
+        return it == outputTypes.end() ? untypedField : it->second;
+    }
+
+    /**
+     * @brief Marks an input field as optional.
+     *
+     * Inputs are required by default: Graph::validate() rejects a required input of a non-root node that
+     * no predecessor produces, and the executor rejects input batches missing a required input of a root
+     * node. An optional input that isn't provided is processed as an empty MiniBatch.
+     *
+     * @param name The name of the input field.
+     * @param optional True if the input may be left unconnected.
+     */
+    void setInputOptional(const std::string& name, bool optional = true) {
+        if (optional) {
+            optionalInputs.insert(name);
+        } else {
+            optionalInputs.erase(name);
+        }
+    }
+
+    /**
+     * @brief Checks if an input field must be provided.
+     *
+     * @param name The name of the input field.
+     * @return True if the input is required, false if it is optional.
+     */
+    bool isInputRequired(const std::string& name) const {
+        return optionalInputs.find(name) == optionalInputs.end();
+    }
+
+    /**
+     * @brief Declares that an output may be written in place over an input.
+     *
+     * The node must compute the output element at index i only from the input element at index i.
+     * The executor then reuses the input storage for the output whenever the node is the last reader
+     * of the input.
+     *
+     * @param inputName The name of the input field.
+     * @param outputName The name of the output field overwriting it.
+     */
+    void setInPlace(const std::string& inputName, const std::string& outputName) {
+        inPlacePorts[inputName] = outputName;
+    }
+
+    /**
+     * @brief Gets the in-place port mapping of the node.
+     *
+     * @return A map of input field names to the output field names that may overwrite them.
+     */
+    const std::map<std::string, std::string>& getInPlacePorts() const {
+        return inPlacePorts;
+    }
+
+    ComputeType getComputeType() const {
+        return computeType;
+    }
+
+    void cleanUp() {
+        for (auto& input : inputs) {
+            input.second = DataContainer();
+        }
+        for (auto& output : outputs) {
+            output.second = DataContainer();
+        }
+        inputBatch.clear();
+        outputBatch.clear();
+    }
+
+private:
+    ComputeType computeType; ///< The compute type of the node (CPU or GPU).
+    std::map<std::string, DataContainer> inputs; ///< Map of input field names to data.
+    std::map<std::string, DataContainer> outputs; ///< Map of output field names to data.
+    std::vector<MiniBatch> inputBatch; ///< The input MiniBatch. (currently only for GPU processing)
+    std::vector<MiniBatch> outputBatch; ///< The output MiniBatch. (currently only for GPU processing)
+    std::map<std::string, std::string> inPlacePorts; ///< Map of input field names to in-place output field names.
+    std::map<std::string, FieldType> inputTypes; ///< Declared types of the input fields.
+    std::map<std::string, FieldType> outputTypes; ///< Declared types of the output fields.
+    std::set<std::string> optionalInputs; ///< Input fields that may be left unconnected.
+    std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> cpuProcess; ///< The CPU processing function.
+    std::function<void(std::map<std::string, DataContainer>&, std::map<std::string, DataContainer>&)> gpuProcess; ///< The GPU processing function.
+    ColumnProcess columnProcess; ///< The CPU processing function over whole MiniBatches, if any.
+    std::shared_ptr<const Expression> expression; ///< The expression computed by the node, if any.
+    double costEstimate = 0.0; ///< Declared seconds per task, 0 if unknown.
+};
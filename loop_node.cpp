@@ -0,0 +1,190 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/7/8
+
+/**
+ * @file loop_node.cpp
+ *
+ * @brief Implements the loop nodes.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by loop_node.h otherwise.
+ */
+
+#include "loop_node.h"
+
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include "executor.h"
+
+namespace loop_node_detail {
+
+/**
+ * @brief A copy of the body with its executor, used by one batch at a time.
+ */
+struct Instance {
+    Graph graph; ///< The compiled body.
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputs; ///< The single input batch of the body.
+    std::unique_ptr<Executor> executor; ///< Executor of the body, created by the first iteration.
+};
+
+/**
+ * @brief State shared by every copy of a loop node.
+ */
+struct Body {
+    Graph graph; ///< The compiled body.
+    LoopSpec spec; ///< The loop description.
+    bool checkFeedback = false; ///< Whether a typed input is fed back from an untyped output.
+    std::mutex mutex; ///< Protects idle.
+    std::vector<std::unique_ptr<Instance>> idle; ///< Instances not running, kept for their buffers.
+};
+
+DAG_INLINE bool hasOutput(const Graph& graph, size_t nodeId, const std::string& field) {
+    return nodeId < graph.size() && graph.getNode(nodeId).getOutputs().count(field) != 0;
+}
+
+DAG_INLINE void runLoop(Body& body, const std::map<std::string, const MiniBatch*>& inputs,
+                        std::map<std::string, MiniBatch*>& outputs) {
+    std::unique_ptr<Instance> instance;
+    {
+        std::lock_guard<std::mutex> lock(body.mutex);
+        if (!body.idle.empty()) {
+            instance = std::move(body.idle.back());
+            body.idle.pop_back();
+        }
+    }
+    if (instance == nullptr) {
+        instance = std::make_unique<Instance>();
+        instance->graph = body.graph;
+        instance->inputs.resize(1);
+    }
+
+    auto& batch = instance->inputs[0];
+    for (const auto& input : inputs) {
+        batch[input.first].getData() = input.second->getData();
+        batch[input.first].getValidity() = input.second->getValidity();
+    }
+    if (instance->executor == nullptr) {
+        instance->executor = std::make_unique<Executor>(instance->graph, instance->inputs);
+        instance->executor->setExecutionMode(ExecutionMode::Inline);
+    } else {
+        instance->executor->reset();
+    }
+
+    const LoopSpec& spec = body.spec;
+    for (size_t iteration = 1;; ++iteration) {
+        instance->executor->run();
+        bool done = iteration >= spec.maxIterations;
+        if (!done && spec.converged) {
+            std::map<std::string, const MiniBatch*> previous;
+            std::map<std::string, const MiniBatch*> next;
+            for (const auto& feedback : spec.feedback) {
+                previous[feedback.input] = &batch[feedback.input];
+                next[feedback.input] = &instance->graph.getMiniBatch(feedback.node, 0, feedback.output);
+            }
+            done = spec.converged(iteration, previous, next);
+        }
+        if (done) {
+            break;
+        }
+        for (const auto& feedback : spec.feedback) {
+            const MiniBatch& next = instance->graph.getMiniBatch(feedback.node, 0, feedback.output);
+            batch[feedback.input].getData() = next.getData();
+            batch[feedback.input].getValidity() = next.getValidity();
+        }
+        // the other inputs are unchanged, and the feedback is typed unless checkFeedback is set
+        instance->executor->reset(body.checkFeedback);
+    }
+
+    for (const auto& output : spec.outputs) {
+        const MiniBatch& result = instance->graph.getMiniBatch(output.second.node, 0, output.second.output);
+        outputs.at(output.first)->getData() = result.getData();
+        outputs.at(output.first)->getValidity() = result.getValidity();
+    }
+    std::lock_guard<std::mutex> lock(body.mutex);
+    body.idle.push_back(std::move(instance));
+}
+
+} // namespace loop_node_detail
+
+DAG_INLINE LoopCondition convergedWithin(double tolerance) {
+    return [tolerance](size_t, const std::map<std::string, const MiniBatch*>& previous,
+                       const std::map<std::string, const MiniBatch*>& next) {
+        for (const auto& field : next) {
+            const MiniBatch& before = *previous.at(field.first);
+            const MiniBatch& after = *field.second;
+            if (before.size() != after.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < after.size(); ++i) {
+                const double* a = std::get_if<double>(&before.getData(i));
+                const double* b = std::get_if<double>(&after.getData(i));
+                if (a != nullptr && b != nullptr && !(std::fabs(*a - *b) <= tolerance)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+}
+
+DAG_INLINE GraphNode makeLoopNode(const Graph& body, LoopSpec spec) {
+    using loop_node_detail::hasOutput;
+    if (body.isBufferReuseEnabled()) {
+        throw std::invalid_argument("Loop body must not reuse buffers.");
+    }
+    if (spec.maxIterations == 0) {
+        throw std::invalid_argument("Loop must run at least one iteration.");
+    }
+    auto state = std::make_shared<loop_node_detail::Body>();
+    state->graph = body;
+    state->graph.compile();
+
+    GraphNode node(ComputeType::CPU);
+    for (size_t rootId : state->graph.getRootNodes()) {
+        const GraphNode& root = state->graph.getNode(rootId);
+        for (const auto& input : root.getInputs()) {
+            if (node.getInputs().count(input.first) != 0) {
+                continue;
+            }
+            node.addInput(input.first, DataContainer());
+            node.setInputType(input.first, root.getInputType(input.first));
+            node.setInputOptional(input.first, !root.isInputRequired(input.first));
+        }
+    }
+    for (const auto& feedback : spec.feedback) {
+        if (!hasOutput(state->graph, feedback.node, feedback.output)) {
+            throw std::invalid_argument("Loop feedback '" + feedback.output + "' is not an output of body node "
+                                        + std::to_string(feedback.node) + ".");
+        }
+        if (node.getInputs().count(feedback.input) == 0) {
+            throw std::invalid_argument("Loop feedback '" + feedback.input + "' is not an input of the body's roots.");
+        }
+        // checked once here rather than by every iteration
+        FieldType inputType = node.getInputType(feedback.input);
+        FieldType outputType = state->graph.getNode(feedback.node).getOutputType(feedback.output);
+        if (inputType != untypedField && outputType == untypedField) {
+            state->checkFeedback = true;
+        } else if (inputType != untypedField && outputType != inputType) {
+            throw std::invalid_argument("Loop feedback '" + feedback.output + "' holds " + fieldTypeName(outputType)
+                                        + ", input '" + feedback.input + "' expects " + fieldTypeName(inputType) + ".");
+        }
+    }
+    for (const auto& output : spec.outputs) {
+        if (!hasOutput(state->graph, output.second.node, output.second.output)) {
+            throw std::invalid_argument("Loop output '" + output.second.output + "' is not an output of body node "
+                                        + std::to_string(output.second.node) + ".");
+        }
+        node.addOutput(output.first, DataContainer());
+        node.setOutputType(output.first, state->graph.getNode(output.second.node).getOutputType(output.second.output));
+    }
+    state->spec = std::move(spec);
+
+    node.setColumnProcess([state](const std::map<std::string, const MiniBatch*>& inputs,
+                                  std::map<std::string, MiniBatch*>& outputs) {
+        loop_node_detail::runLoop(*state, inputs, outputs);
+    });
+    return node;
+}
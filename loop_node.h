@@ -0,0 +1,82 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/7/8
+
+/**
+ * @file loop_node.h
+ *
+ * @brief Nodes iterating a subgraph to a fixed point.
+ *
+ * A loop node runs a body graph over the batch it receives, then feeds designated outputs of the body
+ * back into its root inputs and runs it again, until a convergence condition holds or an iteration cap
+ * is reached. The body keeps one compiled Executor per concurrent batch, which Executor::reset()
+ * rewinds between iterations: nothing is compiled, initialized or allocated again once the sizes are
+ * stable. Iterations run inline on the worker executing the loop node; TaskGroups used by the body's
+ * nodes still reach the workers of the enclosing run.
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dag_config.h"
+#include "graph.h"
+
+/**
+ * @brief An output of the loop body fed back into a root input for the next iteration.
+ */
+struct LoopFeedback {
+    size_t node; ///< The ID of the body node producing the field.
+    std::string output; ///< The output field of the node.
+    std::string input; ///< The root input field receiving it.
+};
+
+/**
+ * @brief Decides after an iteration whether the loop has converged.
+ *
+ * Called with the 1-based number of the iteration that just ran, the values each feedback input had
+ * during the iteration and the values fed back for the next one, keyed by the input field name.
+ */
+using LoopCondition = std::function<bool(size_t iteration, const std::map<std::string, const MiniBatch*>& previous,
+                                         const std::map<std::string, const MiniBatch*>& next)>;
+
+/**
+ * @brief Description of a loop node.
+ */
+struct LoopSpec {
+    std::vector<LoopFeedback> feedback; ///< Fields carried from one iteration to the next.
+    std::map<std::string, LoopFeedback> outputs; ///< Loop node output name to the body field it takes after the last iteration; the input member is ignored.
+    size_t maxIterations = 100; ///< Iteration cap, at least 1.
+    LoopCondition converged; ///< Convergence condition, if empty the loop runs maxIterations times.
+};
+
+/**
+ * @brief Creates a condition holding once no double fed back moves by more than a tolerance.
+ *
+ * @param tolerance Largest absolute change of any element.
+ * @return The condition.
+ */
+LoopCondition convergedWithin(double tolerance);
+
+/**
+ * @brief Creates a node iterating a body graph.
+ *
+ * The inputs of the node are the inputs of the body's root nodes, with their declared types; the
+ * feedback inputs provide the values of the first iteration. The body must not enable buffer reuse,
+ * whose released fields couldn't be read back after an iteration.
+ *
+ * @param body The body graph, compiled by this function.
+ * @param spec The feedback fields, outputs and stopping conditions.
+ * @return The node.
+ * @throws std::invalid_argument If the spec refers to missing nodes or fields, feeds an output back into an
+ *         input of another declared type, or the body reuses buffers.
+ */
+GraphNode makeLoopNode(const Graph& body, LoopSpec spec);
+
+#ifdef DAG_HEADER_ONLY
+    #include "loop_node.cpp"
+#endif
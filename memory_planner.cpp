@@ -0,0 +1,263 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/5/6
+
+/**
+ * @file memory_planner.cpp
+ *
+ * @brief Implements the MemoryPlanner class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by memory_planner.h otherwise.
+ */
+
+#include "memory_planner.h"
+
+DAG_INLINE MemoryPlanner::MemoryPlanner(const std::vector<GraphNode>& nodes, const std::vector<std::vector<size_t>>& successors,
+    const std::vector<std::vector<PortEdge>>& connections, const FieldSizes& fieldSizes, size_t defaultElementSize)
+    : numNodes(nodes.size()), producedValues(nodes.size()), consumedValues(nodes.size()) {
+    std::vector<bool> hasPredecessor(nodes.size(), false);
+    for (const auto& nodeSuccessors : successors) {
+        for (size_t successor : nodeSuccessors) {
+            hasPredecessor[successor] = true;
+        }
+    }
+
+    for (size_t nodeId = 0; nodeId < nodes.size(); ++nodeId) {
+        // fields fed by the input batches are live from the start until the root consumes them
+        if (!hasPredecessor[nodeId]) {
+            for (const auto& input : nodes[nodeId].getInputs()) {
+                size_t valueId = addValue(input.first, nodeId, elementSize(fieldSizes, input.first, defaultElementSize), true);
+                values[valueId].consumers.push_back(nodeId);
+                values[valueId].consumerFields.push_back(input.first);
+                consumedValues[nodeId].push_back(valueId);
+            }
+        }
+        for (const auto& output : nodes[nodeId].getOutputs()) {
+            size_t valueId = addValue(output.first, nodeId, elementSize(fieldSizes, output.first, defaultElementSize), false);
+            producedValues[nodeId].push_back(valueId);
+            for (const auto& port : connections[nodeId]) {
+                if (port.outPort == output.first) {
+                    values[valueId].consumers.push_back(port.to);
+                    values[valueId].consumerFields.push_back(port.inPort);
+                    // a consumer reading the value through several ports releases it once
+                    if (consumedValues[port.to].empty() || consumedValues[port.to].back() != valueId) {
+                        consumedValues[port.to].push_back(valueId);
+                    }
+                }
+            }
+        }
+    }
+
+    predecessorCount.assign(nodes.size(), 0);
+    this->successors = successors;
+    for (const auto& nodeSuccessors : successors) {
+        for (size_t successor : nodeSuccessors) {
+            predecessorCount[successor]++;
+        }
+    }
+}
+
+DAG_INLINE MemoryEstimate MemoryPlanner::estimate(const std::vector<size_t>& batchSizes, const std::vector<ScheduleStep>& schedule) const {
+    MemoryEstimate result;
+    std::vector<std::vector<size_t>> remaining = initialConsumers(batchSizes.size());
+    size_t live = initialBytes(batchSizes);
+
+    result.liveBytes.reserve(schedule.size());
+    for (size_t step = 0; step < schedule.size(); ++step) {
+        size_t nodeId = schedule[step].first;
+        size_t batchId = schedule[step].second;
+        if (nodeId >= numNodes || batchId >= batchSizes.size()) {
+            throw std::out_of_range("Schedule step out of range.");
+        }
+
+        // inputs stay alive while the node writes its outputs
+        live += allocatedBytes(nodeId, batchSizes[batchId]);
+        result.liveBytes.push_back(live);
+        if (live > result.peakBytes) {
+            result.peakBytes = live;
+            result.peakStep = step;
+        }
+        live -= releaseInputs(nodeId, batchId, batchSizes[batchId], remaining);
+    }
+    return result;
+}
+
+DAG_INLINE BufferAssignment MemoryPlanner::assignBuffers(const std::vector<size_t>& order) const {
+    const size_t never = std::numeric_limits<size_t>::max();
+    std::vector<size_t> position(numNodes);
+    for (size_t i = 0; i < order.size(); ++i) {
+        position[order[i]] = i;
+    }
+
+    struct Interval {
+        size_t nodeId;
+        std::string field;
+        size_t elementSize;
+        size_t start;
+        size_t end;
+    };
+    std::vector<Interval> intervals;
+    std::map<std::pair<size_t, std::string>, size_t> intervalOf;
+    auto extend = [&](size_t nodeId, const std::string& field, size_t size, size_t start, size_t end) {
+        auto inserted = intervalOf.insert({{nodeId, field}, intervals.size()});
+        if (inserted.second) {
+            intervals.push_back(Interval{nodeId, field, size, start, end});
+        } else {
+            // a field read and written by the same node, or fed by several predecessors
+            Interval& interval = intervals[inserted.first->second];
+            interval.elementSize = std::max(interval.elementSize, size);
+            interval.start = std::min(interval.start, start);
+            interval.end = std::max(interval.end, end);
+        }
+    };
+
+    for (const auto& value : values) {
+        if (value.isInput) {
+            for (size_t consumer : value.consumers) {
+                extend(consumer, value.field, value.elementSize, 0, position[consumer]);
+            }
+            continue;
+        }
+        size_t start = position[value.producer];
+        extend(value.producer, value.field, value.elementSize, start, value.consumers.empty() ? never : start);
+        for (size_t i = 0; i < value.consumers.size(); ++i) {
+            extend(value.consumers[i], value.consumerFields[i], value.elementSize, start, position[value.consumers[i]]);
+        }
+    }
+
+    std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+        return a.start != b.start ? a.start < b.start : a.end < b.end;
+    });
+
+    BufferAssignment result;
+    result.slots.resize(numNodes);
+    using Active = std::pair<size_t, size_t>; // pair of end step and buffer ID
+    std::priority_queue<Active, std::vector<Active>, std::greater<Active>> active;
+    std::vector<size_t> bufferSize;
+    std::unordered_map<size_t, std::vector<size_t>> freeBuffers; // element size -> released buffers
+    for (const auto& interval : intervals) {
+        while (!active.empty() && active.top().first < interval.start) {
+            size_t buffer = active.top().second;
+            freeBuffers[bufferSize[buffer]].push_back(buffer);
+            active.pop();
+        }
+
+        size_t buffer;
+        auto& candidates = freeBuffers[interval.elementSize];
+        if (!candidates.empty()) {
+            buffer = candidates.back();
+            candidates.pop_back();
+        } else {
+            buffer = bufferSize.size();
+            bufferSize.push_back(interval.elementSize);
+        }
+        if (interval.end != never) {
+            active.push({interval.end, buffer});
+        }
+        result.slots[interval.nodeId][interval.field] = BufferSlot{buffer, interval.end == never};
+    }
+    result.numBuffers = bufferSize.size();
+    return result;
+}
+
+DAG_INLINE MemoryPlan MemoryPlanner::plan(const std::vector<size_t>& batchSizes) const {
+    MemoryPlan result;
+    std::vector<std::vector<size_t>> remaining = initialConsumers(batchSizes.size());
+    std::vector<std::vector<size_t>> waiting(batchSizes.size(), predecessorCount);
+    std::vector<ScheduleStep> ready;
+    for (size_t batchId = 0; batchId < batchSizes.size(); ++batchId) {
+        for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+            if (predecessorCount[nodeId] == 0) {
+                ready.push_back({nodeId, batchId});
+            }
+        }
+    }
+
+    result.schedule.reserve(numNodes * batchSizes.size());
+    while (!ready.empty()) {
+        size_t best = 0;
+        long long bestGrowth = 0;
+        size_t bestAllocated = 0;
+        for (size_t i = 0; i < ready.size(); ++i) {
+            size_t elements = batchSizes[ready[i].second];
+            size_t allocated = allocatedBytes(ready[i].first, elements);
+            long long growth = static_cast<long long>(allocated)
+                - static_cast<long long>(releasableBytes(ready[i].first, ready[i].second, elements, remaining));
+            if (i == 0 || growth < bestGrowth || (growth == bestGrowth && allocated < bestAllocated)) {
+                best = i;
+                bestGrowth = growth;
+                bestAllocated = allocated;
+            }
+        }
+
+        ScheduleStep task = ready[best];
+        ready.erase(ready.begin() + best);
+        releaseInputs(task.first, task.second, batchSizes[task.second], remaining);
+        result.schedule.push_back(task);
+
+        for (size_t successor : successors[task.first]) {
+            if (--waiting[task.second][successor] == 0) {
+                ready.push_back({successor, task.second});
+            }
+        }
+    }
+
+    result.estimate = estimate(batchSizes, result.schedule);
+    return result;
+}
+
+DAG_INLINE size_t MemoryPlanner::addValue(const std::string& field, size_t producer, size_t size, bool isInput) {
+    values.push_back(Value{field, producer, size, isInput, {}, {}});
+    return values.size() - 1;
+}
+
+DAG_INLINE std::vector<std::vector<size_t>> MemoryPlanner::initialConsumers(size_t numBatches) const {
+    std::vector<size_t> counts(values.size(), 0);
+    for (const auto& nodeValues : consumedValues) {
+        for (size_t valueId : nodeValues) {
+            counts[valueId]++;
+        }
+    }
+    return std::vector<std::vector<size_t>>(numBatches, counts);
+}
+
+DAG_INLINE size_t MemoryPlanner::initialBytes(const std::vector<size_t>& batchSizes) const {
+    size_t bytes = 0;
+    for (const auto& value : values) {
+        if (value.isInput) {
+            for (size_t elements : batchSizes) {
+                bytes += value.elementSize * elements;
+            }
+        }
+    }
+    return bytes;
+}
+
+DAG_INLINE size_t MemoryPlanner::allocatedBytes(size_t nodeId, size_t elements) const {
+    size_t bytes = 0;
+    for (size_t valueId : producedValues[nodeId]) {
+        bytes += values[valueId].elementSize * elements;
+    }
+    return bytes;
+}
+
+DAG_INLINE size_t MemoryPlanner::releasableBytes(size_t nodeId, size_t batchId, size_t elements,
+    const std::vector<std::vector<size_t>>& remaining) const {
+    size_t bytes = 0;
+    for (size_t valueId : consumedValues[nodeId]) {
+        if (remaining[batchId][valueId] == 1) {
+            bytes += values[valueId].elementSize * elements;
+        }
+    }
+    return bytes;
+}
+
+DAG_INLINE size_t MemoryPlanner::releaseInputs(size_t nodeId, size_t batchId, size_t elements,
+    std::vector<std::vector<size_t>>& remaining) const {
+    size_t bytes = releasableBytes(nodeId, batchId, elements, remaining);
+    for (size_t valueId : consumedValues[nodeId]) {
+        remaining[batchId][valueId]--;
+    }
+    return bytes;
+}
@@ -0,0 +1,170 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/3/18
+
+/**
+ * @file memory_planner.h
+ *
+ * @brief Estimates and minimizes the peak memory footprint of a graph execution.
+ *
+ * The MemoryPlanner simulates a schedule of (nodeId, batchId) tasks over the fields produced by the
+ * nodes of a graph. Every output field of a node is a value that becomes live when the node runs and
+ * dies after its last consumer has run, so fields whose lifetimes don't overlap can reuse the same buffer.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <map>
+#include <limits>
+#include <queue>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include "dag_config.h"
+#include "graph_node.h"
+
+/**
+ * @brief Bytes per element of each field, keyed by field name.
+ */
+using FieldSizes = std::unordered_map<std::string, size_t>;
+
+/**
+ * @brief A single step of a schedule: pair of nodeId and batchId.
+ */
+using ScheduleStep = std::pair<size_t, size_t>;
+
+/**
+ * @brief Result of simulating a schedule.
+ */
+struct MemoryEstimate {
+    size_t peakBytes = 0; ///< Maximum number of live bytes over the whole schedule.
+    size_t peakStep = 0; ///< Index of the schedule step at which the peak is reached.
+    std::vector<size_t> liveBytes; ///< Live bytes while each step of the schedule executes.
+};
+
+/**
+ * @brief A memory-aware schedule together with its estimate.
+ */
+struct MemoryPlan {
+    std::vector<ScheduleStep> schedule; ///< Order in which the tasks should be executed.
+    MemoryEstimate estimate; ///< Estimate of the schedule.
+};
+
+/**
+ * @brief Physical buffer of a (node, field) MiniBatch.
+ */
+struct BufferSlot {
+    size_t buffer; ///< ID of the physical buffer.
+    bool retained; ///< True if the MiniBatch holds a result and its buffer is never handed back.
+};
+
+/**
+ * @brief Mapping of the MiniBatches of every node to shared physical buffers.
+ *
+ * MiniBatches mapped to the same buffer have disjoint lifetimes, so the storage released by one of
+ * them can be reused by the next one.
+ */
+struct BufferAssignment {
+    size_t numBuffers = 0; ///< Number of physical buffers.
+    std::vector<std::unordered_map<std::string, BufferSlot>> slots; ///< Buffer of each field, for every node.
+};
+
+class MemoryPlanner {
+public:
+    /**
+     * @brief Builds the field lifetimes of a graph.
+     *
+     * @param nodes The nodes of the graph.
+     * @param successors The successor list of every node.
+     * @param connections The port connections leaving every node.
+     * @param fieldSizes Bytes per element of each field, keyed by the name of the producing output.
+     * @param defaultElementSize Bytes per element of fields missing from fieldSizes.
+     */
+    MemoryPlanner(const std::vector<GraphNode>& nodes, const std::vector<std::vector<size_t>>& successors,
+                  const std::vector<std::vector<PortEdge>>& connections, const FieldSizes& fieldSizes,
+                  size_t defaultElementSize = sizeof(DataContainer));
+
+    /**
+     * @brief Simulates a schedule and computes the live bytes at every step.
+     *
+     * @param batchSizes Number of elements of each batch.
+     * @param schedule The tasks in execution order; every task must appear after its predecessors.
+     * @return The estimate of the schedule.
+     */
+    MemoryEstimate estimate(const std::vector<size_t>& batchSizes, const std::vector<ScheduleStep>& schedule) const;
+
+    /**
+     * @brief Assigns physical buffers to the MiniBatches of every node by interval coloring.
+     *
+     * Each (node, field) MiniBatch is live from the step writing it to the last step reading it within a
+     * batch executed in the given order: an output lives until it has been copied to the successors,
+     * an input until its node has run, and an output nobody consumes is a result kept until the end.
+     * Intervals are colored greedily by start step, reusing buffers of the same element size.
+     *
+     * @param order The node IDs in execution order.
+     * @return The buffer assignment.
+     */
+    BufferAssignment assignBuffers(const std::vector<size_t>& order) const;
+
+    /**
+     * @brief Orders the tasks of all batches to keep the peak of live bytes low.
+     *
+     * Greedy list scheduling: among the ready tasks, the one with the smallest net growth of live bytes
+     * runs first, so consumers that free their inputs are preferred over producers of new fields.
+     *
+     * @param batchSizes Number of elements of each batch.
+     * @return The planned schedule and its estimate.
+     */
+    MemoryPlan plan(const std::vector<size_t>& batchSizes) const;
+
+private:
+    /**
+     * @brief A field produced by a node, or fed to a root node by the input batches.
+     */
+    struct Value {
+        std::string field; ///< The name of the field.
+        size_t producer; ///< Node writing the value, unused for input values.
+        size_t elementSize; ///< Bytes per element.
+        bool isInput; ///< True if the value comes from the input batches.
+        std::vector<size_t> consumers; ///< Nodes reading the value.
+        std::vector<std::string> consumerFields; ///< Name of the input field of each consumer.
+    };
+
+    size_t numNodes;
+    std::vector<Value> values;
+    std::vector<std::vector<size_t>> producedValues; ///< Values written by each node.
+    std::vector<std::vector<size_t>> consumedValues; ///< Values read by each node, once per value.
+    std::vector<std::vector<size_t>> successors;
+    std::vector<size_t> predecessorCount;
+
+    static size_t elementSize(const FieldSizes& fieldSizes, const std::string& field, size_t defaultSize) {
+        auto it = fieldSizes.find(field);
+        return it == fieldSizes.end() ? defaultSize : it->second;
+    }
+
+    size_t addValue(const std::string& field, size_t producer, size_t size, bool isInput);
+
+    /**
+     * @brief Number of distinct consumer nodes still to run for every value of every batch.
+     */
+    std::vector<std::vector<size_t>> initialConsumers(size_t numBatches) const;
+
+    size_t initialBytes(const std::vector<size_t>& batchSizes) const;
+
+    size_t allocatedBytes(size_t nodeId, size_t elements) const;
+
+    size_t releasableBytes(size_t nodeId, size_t batchId, size_t elements,
+                           const std::vector<std::vector<size_t>>& remaining) const;
+
+    size_t releaseInputs(size_t nodeId, size_t batchId, size_t elements,
+                         std::vector<std::vector<size_t>>& remaining) const;
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "memory_planner.cpp"
+#endif
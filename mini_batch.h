@@ -1,117 +1,265 @@
-// Copyright (C) 2024 Haochen Jiang
-//
-// Authors: Haochen Jiang
-// Date: 2024/1/2
-
-/**
- * @file mini_batch.h
- *
- * @brief Implements the MiniBatch class.
- *
- * The MiniBatch class encapsulates a collection of data items, each of which can be of various types. It provides
- * functionality to manipulate these data items, and each MiniBatch has an associated name for identification.
- */
-
-#pragma once
-
-#include <vector>
-#include <string>
-#include "data_container.h"
-
-/**
- * @brief The MiniBatch class stores a collection of data items and a name.
- *
- * MiniBatch is primarily used to store and manipulate a sequence of data items. Each data item can be of any type 
- * defined in the DataContainer variant. The class provides methods to add, retrieve, and manage these items.
- */
-class MiniBatch {
-public:
-    /**
-     * @brief Default constructor.
-     */
-    MiniBatch() = default;
-
-    /**
-     * @brief Constructs a MiniBatch with a list of data items.
-     *
-     * @param data A vector of data items to initialize the MiniBatch.
-     */
-    MiniBatch(const std::vector<DataContainer>& data)
-        : batchData(data) {}
-
-    /**
-     * @brief Constructs a MiniBatch with a name and a list of data items.
-     *
-     * @param name The name of the MiniBatch.
-     * @param data A vector of data items to initialize the MiniBatch.
-     */
-    MiniBatch(const std::string& name, const std::vector<DataContainer>& data)
-        : batchName(name), batchData(data) {}
-
-    /**
-     * @brief Adds a data item to the MiniBatch.
-     *
-     * @param data The data item to add.
-     */
-    void addData(const DataContainer& data) {
-        batchData.push_back(data);
-    }
-
-    /**
-     * @brief Retrieves a data item at a specified index.
-     *
-     * @param index The index of the data item.
-     * @return The data item at the specified index.
-     */
-    const DataContainer& getData(size_t index) const {
-        return batchData.at(index);
-    }
-
-    std::vector<DataContainer>& getData() {
-        return batchData;
-    }
-    
-    const std::vector<DataContainer>& getData() const {
-        return batchData;
-    }
-
-    /**
-     * @brief Returns the number of data items in the MiniBatch.
-     *
-     * @return The size of the MiniBatch.
-     */
-    size_t size() const {
-        return batchData.size();
-    }
-
-    /**
-     * @brief Clears all data items from the MiniBatch.
-     */
-    void clear() {
-        batchData.clear();
-    }
-
-    /**
-     * @brief Retrieves the name of the MiniBatch.
-     *
-     * @return The name of the MiniBatch.
-     */
-    const std::string& getName() const {
-        return batchName;
-    }
-
-    /**
-     * @brief Sets the name of the MiniBatch.
-     *
-     * @param name The new name for the MiniBatch.
-     */
-    void setName(const std::string& name) {
-        batchName = name;
-    }
-
-    // Additional methods can be added as needed.
-
-private:
-    std::vector<DataContainer> batchData; ///< Stores the data items of the MiniBatch.
-    std::string batchName; ///< The name of the MiniBatch.
-};
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/1/2
+
+/**
+ * @file mini_batch.h
+ *
+ * @brief Implements the MiniBatch class.
+ *
+ * The MiniBatch class encapsulates a collection of data items, each of which can be of various types. It provides
+ * functionality to manipulate these data items, and each MiniBatch has an associated name for identification.
+ *
+ * Items may be null. Nulls are tracked in a validity bitmap, one bit per item, set when the item is valid,
+ * so kernels combine and count them 64 items at a time instead of testing sentinel values. The bitmap
+ * stays empty as long as every item is valid, and items beyond its end are valid, so batches without
+ * nulls pay nothing.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include "data_container.h"
+#include "buffer_allocator.h"
+
+/**
+ * @brief Storage of the data items of a MiniBatch, aligned and optionally backed by huge pages.
+ */
+using MiniBatchData = std::vector<DataContainer, BufferAllocator<DataContainer>>;
+
+/**
+ * @brief The MiniBatch class stores a collection of data items and a name.
+ *
+ * MiniBatch is primarily used to store and manipulate a sequence of data items. Each data item can be of any type 
+ * defined in the DataContainer variant. The class provides methods to add, retrieve, and manage these items.
+ */
+class MiniBatch {
+public:
+    /**
+     * @brief Default constructor.
+     */
+    MiniBatch() = default;
+
+    /**
+     * @brief Constructs a MiniBatch with a list of data items.
+     *
+     * @param data A vector of data items to initialize the MiniBatch.
+     */
+    MiniBatch(const std::vector<DataContainer>& data)
+        : batchData(data.begin(), data.end()) {}
+
+    /**
+     * @brief Constructs a MiniBatch with a name and a list of data items.
+     *
+     * @param name The name of the MiniBatch.
+     * @param data A vector of data items to initialize the MiniBatch.
+     */
+    MiniBatch(const std::string& name, const std::vector<DataContainer>& data)
+        : batchName(name), batchData(data.begin(), data.end()) {}
+
+    /**
+     * @brief Adds a data item to the MiniBatch.
+     *
+     * @param data The data item to add.
+     */
+    void addData(const DataContainer& data) {
+        batchData.push_back(data);
+    }
+
+    /**
+     * @brief Retrieves a data item at a specified index.
+     *
+     * @param index The index of the data item.
+     * @return The data item at the specified index.
+     */
+    const DataContainer& getData(size_t index) const {
+        return batchData.at(index);
+    }
+
+    MiniBatchData& getData() {
+        return batchData;
+    }
+    
+    const MiniBatchData& getData() const {
+        return batchData;
+    }
+
+    /**
+     * @brief Returns the number of data items in the MiniBatch.
+     *
+     * @return The size of the MiniBatch.
+     */
+    size_t size() const {
+        return batchData.size();
+    }
+
+    /**
+     * @brief Clears all data items from the MiniBatch, and their nulls.
+     */
+    void clear() {
+        batchData.clear();
+        validity.clear();
+    }
+
+    /**
+     * @brief Adds a null item.
+     *
+     * The item holds a default DataContainer, which kernels may read but must not use.
+     */
+    void addNull() {
+        addNulls(1);
+    }
+
+    /**
+     * @brief Adds null items, clearing their validity a word at a time.
+     *
+     * @param count The number of null items.
+     */
+    void addNulls(size_t count) {
+        size_t index = batchData.size();
+        size_t end = index + count;
+        batchData.resize(end);
+        if (validity.size() < (end + 63) / 64) {
+            validity.resize((end + 63) / 64, ~uint64_t(0));
+        }
+        while (index < end) {
+            size_t shift = index % 64;
+            size_t bits = std::min<size_t>(64 - shift, end - index);
+            uint64_t mask = bits == 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1) << shift;
+            validity[index / 64] &= ~mask;
+            index += bits;
+        }
+    }
+
+    /**
+     * @brief Checks if an item is valid, i.e. not null.
+     *
+     * @param index The index of the item.
+     * @return True if the item is valid.
+     */
+    bool isValid(size_t index) const {
+        size_t word = index / 64;
+        return word >= validity.size() || ((validity[word] >> (index % 64)) & 1) != 0;
+    }
+
+    /**
+     * @brief Marks an item as valid or null.
+     *
+     * @param index The index of the item.
+     * @param valid False to make the item null.
+     */
+    void setValid(size_t index, bool valid) {
+        size_t word = index / 64;
+        if (word >= validity.size()) {
+            if (valid) {
+                return;
+            }
+            validity.resize(word + 1, ~uint64_t(0));
+        }
+        uint64_t bit = uint64_t(1) << (index % 64);
+        validity[word] = valid ? validity[word] | bit : validity[word] & ~bit;
+    }
+
+    /**
+     * @brief Clears the validity of a range of items wherever a bitmap has a 0, a word at a time.
+     *
+     * @param offset Index of the first item of the range.
+     * @param bits Validity of the items of the range, bit i for the item at offset + i.
+     * @param count Number of items in the range.
+     */
+    void intersectValidity(size_t offset, const uint64_t* bits, size_t count) {
+        const uint64_t ones = ~uint64_t(0);
+        for (size_t word = 0; word * 64 < count; ++word) {
+            uint64_t value = bits[word];
+            if (count - word * 64 < 64) {
+                value |= ones << (count - word * 64); // past the range
+            }
+            if (value == ones) {
+                continue;
+            }
+            size_t first = offset + word * 64;
+            size_t target = first / 64;
+            size_t shift = first % 64;
+            uint64_t below = (uint64_t(1) << shift) - 1;
+            if (validity.size() < target + 2) {
+                validity.resize(target + 2, ones);
+            }
+            validity[target] &= (value << shift) | below;
+            if (shift != 0) {
+                validity[target + 1] &= (value >> (64 - shift)) | ~below;
+            }
+        }
+    }
+
+    /**
+     * @brief Counts the null items.
+     *
+     * @return The number of null items.
+     */
+    size_t nullCount() const {
+        size_t valid = 0;
+        for (uint64_t word : validity) {
+            valid += std::bitset<64>(word).count();
+        }
+        return validity.size() * 64 - valid;
+    }
+
+    /**
+     * @brief Checks if any item is null.
+     *
+     * @return True if at least one item is null.
+     */
+    bool hasNulls() const {
+        for (uint64_t word : validity) {
+            if (word != ~uint64_t(0)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Gets the validity bitmap: bit i of word i / 64 is set when item i is valid.
+     *
+     * When items are modified through getData(), the caller keeps the bitmap consistent.
+     *
+     * @return The bitmap, empty if every item is valid.
+     */
+    std::vector<uint64_t>& getValidity() {
+        return validity;
+    }
+
+    const std::vector<uint64_t>& getValidity() const {
+        return validity;
+    }
+
+    /**
+     * @brief Retrieves the name of the MiniBatch.
+     *
+     * @return The name of the MiniBatch.
+     */
+    const std::string& getName() const {
+        return batchName;
+    }
+
+    /**
+     * @brief Sets the name of the MiniBatch.
+     *
+     * @param name The new name for the MiniBatch.
+     */
+    void setName(const std::string& name) {
+        batchName = name;
+    }
+
+    // Additional methods can be added as needed.
+
+private:
+    std::string batchName; ///< The name of the MiniBatch.
+    MiniBatchData batchData; ///< Stores the data items of the MiniBatch.
+    std::vector<uint64_t> validity; ///< One bit per item, set if the item is valid; items past the end are valid.
+};
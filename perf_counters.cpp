@@ -0,0 +1,96 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/17
+
+/**
+ * @file perf_counters.cpp
+ *
+ * @brief Implements the hardware performance counters.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by perf_counters.h otherwise.
+ */
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+    #include <cstring>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace perf_counters_detail {
+
+#ifdef __linux__
+DAG_INLINE int openCounter(uint64_t config, int groupFd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = groupFd < 0 ? 1 : 0; // the group starts with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+#endif
+
+} // namespace perf_counters_detail
+
+DAG_INLINE PerfCounters::PerfCounters() {
+    for (size_t i = 0; i < numCounters; ++i) {
+        m_fds[i] = -1;
+        m_slots[i] = numCounters;
+    }
+#ifdef __linux__
+    const uint64_t configs[numCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                           PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (size_t i = 0; i < numCounters; ++i) {
+        m_fds[i] = perf_counters_detail::openCounter(configs[i], m_fds[0]);
+        if (m_fds[i] >= 0) {
+            m_slots[i] = m_opened++;
+        } else if (i == 0) {
+            return;
+        }
+    }
+    ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+DAG_INLINE PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (size_t i = numCounters; i-- > 0;) {
+        if (m_fds[i] >= 0) {
+            close(m_fds[i]);
+        }
+    }
+#endif
+}
+
+DAG_INLINE bool PerfCounters::read(CounterValues& values) const {
+    if (!available()) {
+        return false;
+    }
+#ifdef __linux__
+    // group read format: number of counters, time enabled, time running, then one value per counter
+    uint64_t buffer[3 + numCounters];
+    ssize_t expected = static_cast<ssize_t>((3 + m_opened) * sizeof(uint64_t));
+    if (::read(m_fds[0], buffer, sizeof(buffer)) != expected || buffer[0] != m_opened) {
+        return false;
+    }
+    // the kernel multiplexes the group when other sessions compete for the PMU
+    double scale = buffer[2] != 0 ? static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]) : 0.0;
+    uint64_t* fields[numCounters] = {&values.cycles, &values.instructions, &values.llcMisses, &values.branchMisses};
+    for (size_t i = 0; i < numCounters; ++i) {
+        *fields[i] = m_slots[i] < numCounters ? static_cast<uint64_t>(static_cast<double>(buffer[3 + m_slots[i]]) * scale) : 0;
+    }
+    return true;
+#else
+    (void)values;
+    return false;
+#endif
+}
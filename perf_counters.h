@@ -0,0 +1,78 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/6/17
+
+/**
+ * @file perf_counters.h
+ *
+ * @brief Hardware performance counters of the calling thread, read through perf_event_open.
+ *
+ * A PerfCounters session counts CPU cycles, retired instructions, last level cache misses and branch
+ * misses of the thread that created it, in user space only. The counters are opened as one group so
+ * that they are scheduled together, and are scaled when the kernel multiplexes them. Where
+ * perf_event_open is missing or denied (non-Linux systems, perf_event_paranoid, virtual machines
+ * without a PMU), the session is simply unavailable.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "dag_config.h"
+
+/**
+ * @brief Values of the hardware counters.
+ */
+struct CounterValues {
+    uint64_t cycles = 0; ///< CPU cycles.
+    uint64_t instructions = 0; ///< Retired instructions.
+    uint64_t llcMisses = 0; ///< Last level cache misses.
+    uint64_t branchMisses = 0; ///< Mispredicted branches.
+};
+
+class PerfCounters {
+public:
+    /**
+     * @brief Opens and starts the counters of the calling thread.
+     *
+     * Counters the CPU doesn't provide stay at 0; the session is available as long as cycles can be
+     * counted.
+     */
+    PerfCounters();
+
+    /**
+     * @brief Closes the counters.
+     */
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Checks if the counters could be opened.
+     *
+     * @return True if read() returns counter values.
+     */
+    bool available() const {
+        return m_fds[0] >= 0;
+    }
+
+    /**
+     * @brief Reads the counters, accumulated since the session was opened.
+     *
+     * @param values Receives the counter values.
+     * @return True if the counters were read, false if the session is unavailable or the read failed.
+     */
+    bool read(CounterValues& values) const;
+
+private:
+    static constexpr size_t numCounters = 4;
+    int m_fds[numCounters]; // File descriptors in the order of CounterValues, -1 if not opened
+    size_t m_slots[numCounters]; // Position of each counter in the group read, numCounters if not opened
+    size_t m_opened = 0; // Number of counters opened
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "perf_counters.cpp"
+#endif
@@ -0,0 +1,280 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/4/8
+
+/**
+ * @file recording.cpp
+ *
+ * @brief Implements the Recording class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by recording.h otherwise.
+ */
+
+#include "recording.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+DAG_INLINE void Recording::capture(const Graph& graph,
+    const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches, size_t maxSamples) {
+    nodes.clear();
+    edges.clear();
+    ports.clear();
+    orderings.clear();
+    batches.clear();
+    tasks.clear();
+    for (size_t nodeId = 0; nodeId < graph.size(); ++nodeId) {
+        const GraphNode& node = graph.getNode(nodeId);
+        NodeRecord record;
+        record.computeType = node.getComputeType();
+        for (const auto& input : node.getInputs()) {
+            record.inputs.push_back(input.first);
+        }
+        for (const auto& output : node.getOutputs()) {
+            record.outputs.push_back(output.first);
+        }
+        nodes.push_back(record);
+        for (size_t successor : graph.getSuccessors(nodeId)) {
+            edges.push_back({nodeId, successor});
+            if (graph.getEdgePorts(nodeId, successor).empty()) {
+                orderings.push_back({nodeId, successor});
+            }
+        }
+        const auto& connections = graph.getConnections(nodeId);
+        ports.insert(ports.end(), connections.begin(), connections.end());
+    }
+    for (const auto& batchMap : inputBatches) {
+        std::unordered_map<std::string, FieldRecord> batch;
+        for (const auto& inputField : batchMap) {
+            FieldRecord& field = batch[inputField.first];
+            const auto& data = inputField.second.getData();
+            field.size = data.size();
+            field.samples.assign(data.begin(), data.begin() + std::min(maxSamples, data.size()));
+            field.validity = inputField.second.getValidity();
+        }
+        batches.push_back(batch);
+    }
+}
+
+DAG_INLINE std::vector<ScheduleStep> Recording::schedule() const {
+    std::vector<TaskRecord> ordered = tasks;
+    std::stable_sort(ordered.begin(), ordered.end(), [](const TaskRecord& a, const TaskRecord& b) {
+        return a.start < b.start;
+    });
+    std::vector<ScheduleStep> steps;
+    for (const auto& task : ordered) {
+        steps.push_back({task.nodeId, task.batchId});
+    }
+    return steps;
+}
+
+DAG_INLINE std::vector<std::unordered_map<std::string, MiniBatch>> Recording::inputBatches() const {
+    std::vector<std::unordered_map<std::string, MiniBatch>> result;
+    for (const auto& batch : batches) {
+        std::unordered_map<std::string, MiniBatch> batchMap;
+        for (const auto& field : batch) {
+            MiniBatch miniBatch;
+            for (size_t i = 0; i < field.second.size && !field.second.samples.empty(); ++i) {
+                miniBatch.addData(field.second.samples[i % field.second.samples.size()]);
+            }
+            miniBatch.getValidity() = field.second.validity;
+            batchMap[field.first] = miniBatch;
+        }
+        result.push_back(batchMap);
+    }
+    return result;
+}
+
+DAG_INLINE Graph Recording::syntheticGraph() const {
+    std::vector<double> seconds(nodes.size(), 0.0);
+    std::vector<size_t> elements(nodes.size(), 0);
+    for (const auto& task : tasks) {
+        seconds.at(task.nodeId) += task.seconds;
+        elements.at(task.nodeId) += task.elements;
+    }
+
+    Graph graph;
+    for (size_t nodeId = 0; nodeId < nodes.size(); ++nodeId) {
+        const NodeRecord& record = nodes[nodeId];
+        auto cost = std::chrono::duration<double>(elements[nodeId] > 0 ? seconds[nodeId] / elements[nodeId] : 0.0);
+        std::string source = record.inputs.empty() ? std::string() : record.inputs.front();
+        // synthetic nodes always run on the CPU, GPU nodes are reproduced by their recorded cost
+        GraphNode node(ComputeType::CPU, [cost, source](auto& inputs, auto& outputs) {
+            auto end = std::chrono::steady_clock::now() + cost;
+            while (std::chrono::steady_clock::now() < end) {
+            }
+            for (auto& output : outputs) {
+                output.second = source.empty() ? DataContainer() : inputs[source];
+            }
+        });
+        for (const auto& input : record.inputs) {
+            node.addInput(input, DataContainer());
+        }
+        for (const auto& output : record.outputs) {
+            node.addOutput(output, DataContainer());
+        }
+        graph.addNode(node);
+    }
+    // recordings of version 1 have no ports, their edges connect the fields with the same name
+    for (const auto& port : ports) {
+        graph.addEdge(port.from, port.outPort, port.to, port.inPort);
+    }
+    for (const auto& ordering : orderings) {
+        graph.addOrderingEdge(ordering.first, ordering.second);
+    }
+    if (ports.empty() && orderings.empty()) {
+        for (const auto& edge : edges) {
+            graph.addEdge(edge.first, edge.second);
+        }
+    }
+    return graph;
+}
+
+DAG_INLINE void Recording::save(std::ostream& out) const {
+    out << std::setprecision(std::numeric_limits<long double>::max_digits10);
+    out << "dag-recording 4\n";
+    out << "nodes " << nodes.size() << "\n";
+    for (const auto& node : nodes) {
+        out << "node " << (node.computeType == ComputeType::CPU ? "cpu" : "gpu") << " " << node.inputs.size();
+        for (const auto& input : node.inputs) {
+            out << " " << std::quoted(input);
+        }
+        out << " " << node.outputs.size();
+        for (const auto& output : node.outputs) {
+            out << " " << std::quoted(output);
+        }
+        out << "\n";
+    }
+    out << "edges " << edges.size() << "\n";
+    for (const auto& edge : edges) {
+        out << "edge " << edge.first << " " << edge.second << "\n";
+    }
+    out << "ports " << ports.size() << "\n";
+    for (const auto& port : ports) {
+        out << "port " << port.from << " " << std::quoted(port.outPort) << " " << port.to << " "
+            << std::quoted(port.inPort) << "\n";
+    }
+    out << "orderings " << orderings.size() << "\n";
+    for (const auto& ordering : orderings) {
+        out << "ordering " << ordering.first << " " << ordering.second << "\n";
+    }
+    out << "batches " << batches.size() << "\n";
+    for (const auto& batch : batches) {
+        out << "batch " << batch.size() << "\n";
+        for (const auto& field : batch) {
+            out << "field " << std::quoted(field.first) << " " << field.second.size << " "
+                << field.second.samples.size();
+            for (const auto& sample : field.second.samples) {
+                out << " " << sample.index() << " ";
+                std::visit([&out](const auto& value) { writeValue(out, value); }, sample);
+            }
+            out << " " << field.second.validity.size();
+            for (uint64_t word : field.second.validity) {
+                out << " " << word;
+            }
+            out << "\n";
+        }
+    }
+    out << "tasks " << tasks.size() << "\n";
+    for (const auto& task : tasks) {
+        out << "task " << task.nodeId << " " << task.batchId << " " << task.worker << " " << task.elements
+            << " " << task.start << " " << task.seconds << "\n";
+    }
+}
+
+DAG_INLINE Recording Recording::load(std::istream& in) {
+    Recording recording;
+    size_t version = 0;
+    expect(in, "dag-recording");
+    in >> version;
+    if (version < 1 || version > 4) {
+        throw std::runtime_error("Unsupported recording version.");
+    }
+
+    recording.nodes.resize(readCount(in, "nodes"));
+    for (auto& node : recording.nodes) {
+        std::string computeType;
+        expect(in, "node");
+        in >> computeType;
+        node.computeType = computeType == "gpu" ? ComputeType::GPU : ComputeType::CPU;
+        node.inputs.resize(readCount(in));
+        for (auto& input : node.inputs) {
+            in >> std::quoted(input);
+        }
+        node.outputs.resize(readCount(in));
+        for (auto& output : node.outputs) {
+            in >> std::quoted(output);
+        }
+    }
+
+    recording.edges.resize(readCount(in, "edges"));
+    for (auto& edge : recording.edges) {
+        expect(in, "edge");
+        in >> edge.first >> edge.second;
+    }
+    if (version >= 2) {
+        recording.ports.resize(readCount(in, "ports"));
+        for (auto& port : recording.ports) {
+            expect(in, "port");
+            in >> port.from >> std::quoted(port.outPort) >> port.to >> std::quoted(port.inPort);
+        }
+    }
+    if (version >= 3) {
+        recording.orderings.resize(readCount(in, "orderings"));
+        for (auto& ordering : recording.orderings) {
+            expect(in, "ordering");
+            in >> ordering.first >> ordering.second;
+        }
+    }
+
+    recording.batches.resize(readCount(in, "batches"));
+    for (auto& batch : recording.batches) {
+        size_t numFields = readCount(in, "batch");
+        for (size_t i = 0; i < numFields; ++i) {
+            std::string name;
+            expect(in, "field");
+            in >> std::quoted(name);
+            FieldRecord& field = batch[name];
+            in >> field.size;
+            field.samples.resize(readCount(in));
+            for (auto& sample : field.samples) {
+                sample = readSample(in);
+            }
+            if (version >= 4) {
+                field.validity.resize(readCount(in));
+                for (auto& word : field.validity) {
+                    in >> word;
+                }
+            }
+        }
+    }
+
+    recording.tasks.resize(readCount(in, "tasks"));
+    for (auto& task : recording.tasks) {
+        expect(in, "task");
+        in >> task.nodeId >> task.batchId >> task.worker >> task.elements >> task.start >> task.seconds;
+    }
+    if (!in) {
+        throw std::runtime_error("Malformed recording.");
+    }
+    return recording;
+}
+
+DAG_INLINE void Recording::expect(std::istream& in, const std::string& keyword) {
+    std::string token;
+    in >> token;
+    if (token != keyword) {
+        throw std::runtime_error("Malformed recording: expected " + keyword + ".");
+    }
+}
+
+DAG_INLINE size_t Recording::readCount(std::istream& in, const std::string& keyword) {
+    if (!keyword.empty()) {
+        expect(in, keyword);
+    }
+    size_t count = 0;
+    in >> count;
+    return count;
+}
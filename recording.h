@@ -0,0 +1,193 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/4/8
+
+/**
+ * @file recording.h
+ *
+ * @brief Captures a graph execution so that it can be replayed deterministically.
+ *
+ * A Recording holds the graph definition (ports of every node and edges), the shapes and a sample of
+ * the values of every input batch, and the order and timing of every task observed by the Executor.
+ * Recordings are saved to and loaded from a plain text format.
+ */
+
+#pragma once
+
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "dag_config.h"
+#include "graph.h"
+#include "memory_planner.h"
+
+/**
+ * @brief Ports of a recorded node.
+ */
+struct NodeRecord {
+    ComputeType computeType = ComputeType::CPU; ///< The compute type of the node.
+    std::vector<std::string> inputs; ///< Names of the input fields.
+    std::vector<std::string> outputs; ///< Names of the output fields.
+};
+
+/**
+ * @brief Shape and sample values of a recorded input field.
+ */
+struct FieldRecord {
+    size_t size = 0; ///< Number of elements of the field in the batch.
+    std::vector<DataContainer> samples; ///< The first elements of the field.
+    std::vector<uint64_t> validity; ///< Validity bitmap of the whole field, empty if it has no null.
+};
+
+/**
+ * @brief Timing of a single recorded task.
+ */
+struct TaskRecord {
+    size_t nodeId = 0; ///< The ID of the node.
+    size_t batchId = 0; ///< The ID of the batch.
+    size_t worker = 0; ///< Index of the worker thread that executed the task.
+    size_t elements = 0; ///< Number of input elements processed.
+    double start = 0.0; ///< Start time in seconds, relative to the start of the run.
+    double seconds = 0.0; ///< Execution time in seconds.
+};
+
+class Recording {
+public:
+    std::vector<NodeRecord> nodes; ///< Ports of each node.
+    std::vector<std::pair<size_t, size_t>> edges; ///< The (from, to) edges.
+    std::vector<PortEdge> ports; ///< The port connections of the edges.
+    std::vector<std::pair<size_t, size_t>> orderings; ///< The (from, to) edges passing no field.
+    std::vector<std::unordered_map<std::string, FieldRecord>> batches; ///< Input fields of each batch.
+    std::vector<TaskRecord> tasks; ///< Recorded tasks, in completion order.
+
+    /**
+     * @brief Captures the definition of a compiled graph and its input batches.
+     *
+     * @param graph The compiled graph.
+     * @param inputBatches The input MiniBatches of each batch.
+     * @param maxSamples Maximum number of values kept per input field.
+     */
+    void capture(const Graph& graph, const std::vector<std::unordered_map<std::string, MiniBatch>>& inputBatches,
+                 size_t maxSamples = 16);
+
+    /**
+     * @brief The recorded tasks in the order they started.
+     *
+     * @return The schedule observed during the recording.
+     */
+    std::vector<ScheduleStep> schedule() const;
+
+    /**
+     * @brief Recreates the input batches, repeating the samples up to the recorded sizes, with the
+     *        recorded nulls.
+     *
+     * @return The input MiniBatches of each batch.
+     */
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputBatches() const;
+
+    /**
+     * @brief Builds a graph with the recorded structure whose nodes reproduce the recorded cost.
+     *
+     * Each synthetic node spins for the average recorded time per element of its original node, then
+     * forwards its first input value to every output.
+     *
+     * @return The synthetic graph.
+     */
+    Graph syntheticGraph() const;
+
+    /**
+     * @brief Writes the recording in text format.
+     *
+     * @param out The stream to write to.
+     */
+    void save(std::ostream& out) const;
+
+    /**
+     * @brief Reads a recording written by save().
+     *
+     * @param in The stream to read from.
+     * @return The recording.
+     */
+    static Recording load(std::istream& in);
+
+private:
+    // the value readers and writers are templates over the alternatives of DataContainer, they stay here
+    template <typename T>
+    static void writeValue(std::ostream& out, const T& value) {
+        out << value;
+    }
+
+    static void writeValue(std::ostream& out, const std::string& value) {
+        out << std::quoted(value);
+    }
+
+    template <typename T>
+    static void writeValue(std::ostream& out, const std::vector<T>& values) {
+        out << values.size();
+        for (const auto& value : values) {
+            out << " ";
+            writeValue(out, value);
+        }
+    }
+
+    template <typename T>
+    static void readValue(std::istream& in, T& value) {
+        in >> value;
+    }
+
+    static void readValue(std::istream& in, std::string& value) {
+        in >> std::quoted(value);
+    }
+
+    template <typename T>
+    static void readValue(std::istream& in, std::vector<T>& values) {
+        values.resize(readCount(in));
+        for (auto& value : values) {
+            readValue(in, value);
+        }
+    }
+
+    template <size_t Index>
+    static DataContainer readAlternative(std::istream& in) {
+        std::variant_alternative_t<Index, DataContainer> value{};
+        readValue(in, value);
+        return value;
+    }
+
+    template <size_t... Indices>
+    static DataContainer readSample(std::istream& in, size_t index, std::index_sequence<Indices...>) {
+        using Reader = DataContainer (*)(std::istream&);
+        static const Reader readers[] = {&readAlternative<Indices>...};
+        if (index >= sizeof...(Indices)) {
+            throw std::runtime_error("Malformed recording.");
+        }
+        return readers[index](in);
+    }
+
+    static DataContainer readSample(std::istream& in) {
+        size_t index = 0;
+        in >> index;
+        return readSample(in, index, std::make_index_sequence<std::variant_size_v<DataContainer>>());
+    }
+
+    /**
+     * @brief Reads the next token, which must be the keyword.
+     */
+    static void expect(std::istream& in, const std::string& keyword);
+
+    /**
+     * @brief Reads a count, preceded by the keyword unless it is empty.
+     */
+    static size_t readCount(std::istream& in, const std::string& keyword = std::string());
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "recording.cpp"
+#endif
@@ -0,0 +1,65 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/4/8
+
+/**
+ * @file replay.cpp
+ *
+ * @brief Implements the Replayer class.
+ *
+ * Compiled into the library when DAG_COMPILED_LIB is defined, included by replay.h otherwise.
+ */
+
+#include "replay.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DAG_INLINE ReplayPolicy parseReplayPolicy(const std::string& name) {
+    if (name == "recorded") {
+        return ReplayPolicy::Recorded;
+    }
+    if (name == "default") {
+        return ReplayPolicy::Default;
+    }
+    if (name == "memory") {
+        return ReplayPolicy::MemoryPlanned;
+    }
+    throw std::invalid_argument("Unknown replay policy: " + name);
+}
+
+DAG_INLINE Replayer::Replayer(const Recording& recording)
+    : m_recording(recording), m_inputBatches(recording.inputBatches()) {}
+
+DAG_INLINE ExecutorStats Replayer::replay(Graph& graph, ReplayPolicy policy) const {
+    if (graph.size() != m_recording.nodes.size()) {
+        throw std::invalid_argument("Graph doesn't match the recording.");
+    }
+    graph.compile();
+    Executor executor(graph, m_inputBatches);
+    if (policy == ReplayPolicy::Recorded) {
+        executor.setSchedule(m_recording.schedule());
+    } else if (policy == ReplayPolicy::MemoryPlanned) {
+        executor.setSchedule(graph.planMemory(FieldSizes(), batchSizes()).schedule);
+    }
+    executor.run();
+    return executor.getStats();
+}
+
+DAG_INLINE ExecutorStats Replayer::replay(ReplayPolicy policy) const {
+    Graph graph = m_recording.syntheticGraph();
+    return replay(graph, policy);
+}
+
+DAG_INLINE std::vector<size_t> Replayer::batchSizes() const {
+    std::vector<size_t> sizes;
+    for (const auto& batchMap : m_inputBatches) {
+        size_t size = 0;
+        for (const auto& inputField : batchMap) {
+            size = std::max(size, inputField.second.size());
+        }
+        sizes.push_back(size);
+    }
+    return sizes;
+}
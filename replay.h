@@ -0,0 +1,80 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/4/8
+
+/**
+ * @file replay.h
+ *
+ * @brief Re-executes a Recording under the recorded schedule or another scheduling policy.
+ *
+ * The Replayer runs the recorded inputs either through the original graph, rebuilt by the caller, or
+ * through a synthetic graph reproducing the recorded structure and per-node cost, so that scheduling
+ * policies can be compared on captured workloads.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dag_config.h"
+#include "executor.h"
+#include "recording.h"
+
+/**
+ * @brief Order in which the replayed tasks are submitted.
+ */
+enum class ReplayPolicy {
+    Recorded, ///< The order in which the tasks started during the recording.
+    Default, ///< The default order of the Executor.
+    MemoryPlanned ///< The order planned by Graph::planMemory().
+};
+
+/**
+ * @brief Parses a policy name: "recorded", "default" or "memory".
+ *
+ * @param name The name of the policy.
+ * @return The policy.
+ */
+ReplayPolicy parseReplayPolicy(const std::string& name);
+
+class Replayer {
+public:
+    /**
+     * @brief Constructs a Replayer for a recording.
+     *
+     * @param recording The recording to replay. It must outlive the Replayer.
+     */
+    explicit Replayer(const Recording& recording);
+
+    /**
+     * @brief Replays the recorded inputs through a graph.
+     *
+     * @param graph A freshly built graph with the recorded structure.
+     * @param policy The scheduling policy.
+     * @return The statistics of the replayed run.
+     */
+    ExecutorStats replay(Graph& graph, ReplayPolicy policy) const;
+
+    /**
+     * @brief Replays the recorded inputs through a synthetic graph reproducing the recorded cost.
+     *
+     * @param policy The scheduling policy.
+     * @return The statistics of the replayed run.
+     */
+    ExecutorStats replay(ReplayPolicy policy) const;
+
+private:
+    const Recording& m_recording;
+    std::vector<std::unordered_map<std::string, MiniBatch>> m_inputBatches;
+
+    /**
+     * @brief Number of elements of each recorded batch, the size of its largest field.
+     */
+    std::vector<size_t> batchSizes() const;
+};
+
+#ifdef DAG_HEADER_ONLY
+    #include "replay.cpp"
+#endif
@@ -0,0 +1,79 @@
+#include <fstream>
+#include <iostream>
+#include "dag.h"
+#include "replay.h"
+
+// records the multiply/divide example of test_dag.cpp
+static int record(const std::string& path) {
+    Graph graph;
+
+    GraphNode multiplyNode(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        double inputVal = std::get<double>(inputs["multiplyin"]);
+        outputs["multiplyout"] = inputVal * 2;
+    });
+    multiplyNode.addInput("multiplyin", DataContainer());
+    multiplyNode.addOutput("multiplyout", DataContainer());
+
+    GraphNode divideNode(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        double inputVal = std::get<double>(inputs["multiplyout"]);
+        outputs["divideout"] = inputVal / 10;
+    });
+    divideNode.addInput("multiplyout", DataContainer());
+    divideNode.addOutput("divideout", DataContainer());
+
+    size_t multiplyNodeId = graph.addNode(multiplyNode);
+    size_t divideNodeId = graph.addNode(divideNode);
+    graph.addEdge(multiplyNodeId, divideNodeId);
+
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputBatches;
+    for (size_t batchId = 0; batchId < 4; ++batchId) {
+        MiniBatch batch;
+        for (size_t i = 0; i < 1000; ++i) {
+            batch.addData(static_cast<double>(batchId * 1000 + i));
+        }
+        inputBatches.push_back({{"multiplyin", batch}});
+    }
+
+    Recording recording;
+    Executor executor(graph, inputBatches);
+    executor.setRecording(&recording);
+    executor.run();
+
+    std::ofstream out(path);
+    recording.save(out);
+    std::cout << "Recorded " << recording.tasks.size() << " tasks to " << path << std::endl;
+    return out ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: replay_dag record <file>\n"
+                  << "       replay_dag <file> [recorded|default|memory]...\n";
+        return 1;
+    }
+    if (std::string(argv[1]) == "record") {
+        return argc > 2 ? record(argv[2]) : 1;
+    }
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    Recording recording = Recording::load(in);
+    Replayer replayer(recording);
+
+    std::vector<std::string> policies;
+    for (int i = 2; i < argc; ++i) {
+        policies.push_back(argv[i]);
+    }
+    if (policies.empty()) {
+        policies = {"recorded", "default", "memory"};
+    }
+
+    for (const auto& policy : policies) {
+        ExecutorStats stats = replayer.replay(parseReplayPolicy(policy));
+        std::cout << "Policy " << policy << ": " << stats.wallSeconds * 1e3 << " ms" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+// Copyright (C) 2024 Haochen Jiang
+//
+// Authors: Haochen Jiang
+// Date: 2024/7/1
+
+/**
+ * @file task_group.h
+ *
+ * @brief Child tasks spawned from inside node bodies, run by the executor's own workers.
+ *
+ * A node with internal parallelism creates a TaskGroup in its processing function, submits one child
+ * task per partition with run() and joins them with wait(). The children go to the TaskPool of the
+ * executor run, whose idle workers pick them up, so no thread is created and the machine isn't
+ * oversubscribed. While waiting, the node's thread runs pending child tasks itself instead of
+ * blocking, so a group always completes, even when every other worker is busy or has finished.
+ * Outside of an executor run, children are simply run by wait().
+ *
+ * Header-only: the executor includes it and node bodies use TaskGroup directly.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "dag_config.h"
+
+/**
+ * @brief Queue of the child tasks of an executor run.
+ *
+ * The workers of the run execute child tasks between their DAG tasks, and once the DAG tasks are all
+ * taken they block on the pool until it is closed, at the end of the last DAG task.
+ */
+class TaskPool {
+public:
+    /**
+     * @brief Makes a pool the target of the TaskGroups created by the calling thread, for the
+     *        lifetime of the scope.
+     */
+    class Scope {
+    public:
+        explicit Scope(TaskPool* pool) : m_previous(slot()) {
+            slot() = pool;
+        }
+
+        ~Scope() {
+            slot() = m_previous;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TaskPool* m_previous; // Pool of the enclosing scope, restored on exit
+    };
+
+    /**
+     * @brief Gets the pool of the calling thread.
+     *
+     * @return The pool of the executor run the thread works for, nullptr outside of a run.
+     */
+    static TaskPool* current() {
+        return slot();
+    }
+
+    /**
+     * @brief Opens the pool for a run.
+     *
+     * @param closed True if the run has no DAG task, so that workers don't wait for children.
+     */
+    void open(bool closed) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = closed;
+    }
+
+    /**
+     * @brief Wakes the workers waiting for child tasks and lets them leave once the pool is empty.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_cond.notify_all();
+    }
+
+    /**
+     * @brief Adds a child task.
+     *
+     * @param task The task.
+     */
+    void submit(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+        m_cond.notify_one();
+    }
+
+    /**
+     * @brief Runs one pending child task, if any, without blocking.
+     *
+     * @return True if a task was run.
+     */
+    bool tryRun() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_tasks.empty()) {
+                return false;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    /**
+     * @brief Waits for a child task and runs it.
+     *
+     * @return True if a task was run, false once the pool is closed and empty.
+     */
+    bool runOrWait() {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this] { return !m_tasks.empty() || m_closed; });
+            if (m_tasks.empty()) {
+                return false;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+private:
+    std::deque<std::function<void()>> m_tasks; // Pending child tasks, oldest first
+    alignas(DAG_CACHE_LINE_SIZE) std::mutex m_mutex; // Protects m_tasks and m_closed
+    std::condition_variable m_cond; // Signals a new task or the closing of the pool
+    bool m_closed = true; // Whether every DAG task of the run has completed
+
+    /**
+     * @brief Pool of the calling thread.
+     */
+    static TaskPool*& slot() {
+        static thread_local TaskPool* pool = nullptr;
+        return pool;
+    }
+};
+
+/**
+ * @brief A set of child tasks joined together, for use inside node processing functions.
+ *
+ * The group must be waited for before it is destroyed; the destructor waits otherwise. Captured
+ * references must stay valid until wait() returns.
+ */
+class TaskGroup {
+public:
+    /**
+     * @brief Creates a group submitting to the pool of the executor run of the calling thread.
+     */
+    TaskGroup() : m_pool(TaskPool::current()) {}
+
+    /**
+     * @brief Waits for the children still running, dropping their exceptions.
+     */
+    ~TaskGroup() {
+        join();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * @brief Submits a child task.
+     *
+     * @param task A callable taking no argument, run by any worker of the executor or by wait().
+     */
+    template <typename Task>
+    void run(Task&& task) {
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        std::function<void()> child = [this, task = std::forward<Task>(task)]() mutable {
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                if (!m_error) {
+                    m_error = std::current_exception();
+                }
+            }
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+        };
+        if (m_pool != nullptr) {
+            m_pool->submit(std::move(child));
+        } else {
+            m_local.push_back(std::move(child));
+        }
+    }
+
+    /**
+     * @brief Waits for every child task submitted so far, running pending child tasks meanwhile.
+     *
+     * @throws The first exception thrown by a child task, if any.
+     */
+    void wait() {
+        join();
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(m_errorMutex);
+            std::swap(error, m_error);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    TaskPool* m_pool; // Pool of the executor run, nullptr outside of a run
+    std::deque<std::function<void()>> m_local; // Children waiting for wait(), outside of a run
+    std::atomic<size_t> m_pending{0}; // Children not completed yet
+    std::mutex m_errorMutex; // Protects m_error
+    std::exception_ptr m_error; // First exception thrown by a child
+
+    /**
+     * @brief Runs or waits for the pending children.
+     */
+    void join() {
+        while (!m_local.empty()) {
+            std::function<void()> child = std::move(m_local.front());
+            m_local.pop_front();
+            child();
+        }
+        // children of other groups may run here too, their groups wait for them just the same
+        while (m_pending.load(std::memory_order_acquire) != 0) {
+            if (m_pool == nullptr || !m_pool->tryRun()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
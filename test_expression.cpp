@@ -0,0 +1,264 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "dag.h"
+
+static size_t failures = 0;
+
+static void expect(bool condition, const std::string& what) {
+    std::cout << what << ": " << (condition ? "ok" : "FAILED") << "\n";
+    if (!condition) {
+        failures++;
+    }
+}
+
+static bool parseFails(const std::string& text) {
+    try {
+        Expression expression(text);
+    } catch (const std::invalid_argument& error) {
+        std::cout << "  " << error.what() << "\n";
+        return true;
+    }
+    return false;
+}
+
+int main() {
+    // precedence, functions and select, one row at a time
+    Expression arithmetic("1 + 2 * x - y / 4 % 3");
+    expect(arithmetic.evaluate({{"x", 5.0}, {"y", 14}}) == 1 + 2 * 5.0 - std::fmod(14 / 4.0, 3), "Precedence");
+    Expression select("x > 0 && !(y == 2) ? sqrt(x) * 2 : max(-x, pow(y, 2))");
+    expect(select.evaluate({{"x", 9.0}, {"y", 1.0}}) == 6.0, "Select true branch");
+    expect(select.evaluate({{"x", -1.0}, {"y", 3.0}}) == 9.0, "Select false branch");
+    expect(select.getColumns() == std::vector<std::string>{"x", "y"}, "Columns in order of first use");
+
+    // constant folding leaves no instruction for constant subexpressions and identities
+    Expression folded("(2 * 3 + 1) * x * 1 - 0 + (1 < 2 ? y : x)");
+    std::cout << "Folded: " << folded.toString() << ", " << folded.getInstructions().size() << " instructions (Expected 2)\n";
+    expect(folded.getInstructions().size() == 2, "Constant folding");
+    expect(Expression(folded.toString()).toString() == folded.toString(), "Printed expression parses back");
+    expect(Expression("-(-x)").getInstructions().empty(), "Double negation folded");
+
+    // signed zeros: -0 has its own register, and only the identities exact for -0 are folded
+    Expression signedZeros("x * 0 + x / -0");
+    std::cout << "Signed zero constants: " << signedZeros.evaluate({{"x", 1.0}}) << " (Expected -inf)\n";
+    expect(signedZeros.evaluate({{"x", 1.0}}) == -std::numeric_limits<double>::infinity(), "-0 not merged with 0");
+    Expression plusZero("x + 0");
+    expect(!std::signbit(plusZero.evaluate({{"x", -0.0}})), "x + 0 not folded, -0 + 0 is 0");
+    expect(Expression("x + -0").getInstructions().empty() && Expression("x - 0").getInstructions().empty(),
+           "Exact zero identities folded");
+
+    // column evaluation over more rows than a chunk, with temporaries reused
+    const size_t rows = 3 * Expression::chunkSize + 5;
+    std::vector<double> x(rows);
+    std::vector<double> y(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        x[i] = static_cast<double>(i) - 50;
+        y[i] = static_cast<double>(i % 7);
+    }
+    Expression polynomial("(x * x + 3 * x - y) * (y + 1) - abs(x) / (y + 1)");
+    std::vector<double> out(rows);
+    polynomial.evaluate({x.data(), y.data()}, rows, out.data());
+    bool match = true;
+    for (size_t i = 0; i < rows; ++i) {
+        match = match && out[i] == (x[i] * x[i] + 3 * x[i] - y[i]) * (y[i] + 1) - std::fabs(x[i]) / (y[i] + 1);
+    }
+    expect(match, "Chunked column evaluation");
+
+    // malformed expressions report their position
+    expect(parseFails("x +"), "Rejects a missing operand");
+    expect(parseFails("(x + 1"), "Rejects an unbalanced parenthesis");
+    expect(parseFails("foo(x)"), "Rejects an unknown function");
+    expect(parseFails("x ? 1"), "Rejects an incomplete select");
+
+    // a chain of expression nodes behind a regular node, run unfused and fused
+    auto buildGraph = [] {
+        Graph graph;
+        GraphNode source(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+            outputs["a"] = std::get<double>(inputs["in"]) + 1;
+        });
+        source.addInput("in", DataContainer());
+        source.addOutput("a", DataContainer());
+        size_t sourceId = graph.addNode(source);
+        size_t scaleId = graph.addNode(makeExpressionNode("b", "a * 2 + 1"));
+        size_t clampId = graph.addNode(makeExpressionNode("c", "min(v, 20) - 1"));
+        size_t sinkId = graph.addNode(makeExpressionNode("d", "c >= 0 ? c : 0"));
+        graph.addEdge(sourceId, scaleId);
+        graph.addEdge(scaleId, "b", clampId, "v");
+        graph.addEdge(clampId, sinkId);
+        return graph;
+    };
+
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputs(2);
+    inputs[0]["in"] = MiniBatch({1.0, 5.0, -4.0});
+    inputs[1]["in"] = MiniBatch({100.0, -1.5});
+    std::vector<std::vector<double>> expected = {{4, 12, 0}, {19, 0}};
+
+    Graph unfused = buildGraph();
+    std::vector<size_t> nodeMap;
+    Graph fused = fuseExpressions(unfused, &nodeMap);
+    std::cout << "Fused nodes: " << fused.size() << " (Expected 2), sink expression: "
+              << fused.getNode(nodeMap[3]).getExpression()->toString() << "\n";
+    expect(fused.size() == 2 && nodeMap[1] == nodeMap[3] && nodeMap[2] == nodeMap[3], "Fusion of the expression chain");
+    // "c" is read twice by the sink, its substituted expression is computed once
+    expect(fused.getNode(nodeMap[3]).getExpression()->getInstructions().size() == 6, "Shared subexpression computed once");
+
+    for (Graph* graph : {&unfused, &fused}) {
+        Executor executor(*graph, inputs);
+        executor.run();
+        size_t sinkId = graph == &unfused ? 3 : nodeMap[3];
+        bool same = true;
+        for (size_t batchId = 0; batchId < inputs.size(); ++batchId) {
+            const MiniBatch& result = graph->getMiniBatch(sinkId, batchId, "d");
+            same = same && result.size() == expected[batchId].size();
+            for (size_t i = 0; same && i < result.size(); ++i) {
+                same = std::get<double>(result.getData(i)) == expected[batchId][i];
+            }
+        }
+        expect(same, graph == &unfused ? "Unfused graph results" : "Fused graph results");
+    }
+
+    // a root expression node with two columns fused with its consumer
+    Graph rootGraph;
+    size_t sumId = rootGraph.addNode(makeExpressionNode("s", "p + q"));
+    size_t halfId = rootGraph.addNode(makeExpressionNode("h", "s / 2"));
+    rootGraph.addEdge(sumId, halfId);
+    Graph rootFused = fuseExpressions(rootGraph);
+    std::vector<std::unordered_map<std::string, MiniBatch>> rootInputs(1);
+    rootInputs[0]["p"] = MiniBatch({1, 2, 3});
+    rootInputs[0]["q"] = MiniBatch({3.0f, 4.0f, 5.0f});
+    Executor rootExecutor(rootFused, rootInputs);
+    rootExecutor.run();
+    const MiniBatch& half = rootFused.getMiniBatch(0, 0, "h");
+    expect(rootFused.size() == 1 && half.size() == 3 && std::get<double>(half.getData(2)) == 4.0, "Fused root node");
+
+    // an ordering edge, passing no field, survives fusion
+    Graph orderedGraph;
+    size_t orderedSum = orderedGraph.addNode(makeExpressionNode("s", "p + q"));
+    size_t orderedHalf = orderedGraph.addNode(makeExpressionNode("h", "s / 2"));
+    size_t orderedTriple = orderedGraph.addNode(makeExpressionNode("t", "s * 3"));
+    orderedGraph.addEdge(orderedSum, orderedHalf);
+    orderedGraph.addEdge(orderedSum, orderedTriple);
+    orderedGraph.addOrderingEdge(orderedHalf, orderedTriple);
+    std::vector<size_t> orderedMap;
+    Graph orderedFused = fuseExpressions(orderedGraph, &orderedMap);
+    expect(orderedFused.size() == 3 && orderedFused.edgeExists(orderedMap[orderedHalf], orderedMap[orderedTriple])
+               && orderedFused.getEdgePorts(orderedMap[orderedHalf], orderedMap[orderedTriple]).empty(),
+           "Ordering edge kept by fusion");
+
+    // a consumer writing the field its producer reads is left unfused, y = y * 2 + 1 would read its own output
+    Graph shadowGraph;
+    GraphNode shadowSource(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        outputs["y"] = std::get<double>(inputs["in"]);
+    });
+    shadowSource.addInput("in", DataContainer());
+    shadowSource.addOutput("y", DataContainer());
+    size_t shadowSourceId = shadowGraph.addNode(shadowSource);
+    size_t shadowScale = shadowGraph.addNode(makeExpressionNode("t", "y * 2"));
+    size_t shadowShift = shadowGraph.addNode(makeExpressionNode("y", "t + 1"));
+    shadowGraph.addEdge(shadowSourceId, shadowScale);
+    shadowGraph.addEdge(shadowScale, shadowShift);
+    std::vector<size_t> shadowMap;
+    Graph shadowFused = fuseExpressions(shadowGraph, &shadowMap);
+    std::vector<std::unordered_map<std::string, MiniBatch>> shadowInputs(1);
+    shadowInputs[0]["in"] = MiniBatch({2.0});
+    Executor shadowExecutor(shadowFused, shadowInputs);
+    shadowExecutor.run();
+    const MiniBatch& shadowResult = shadowFused.getMiniBatch(shadowMap[shadowShift], 0, "y");
+    std::cout << "Output shadowing a column: " << std::get<double>(shadowResult.getData(0)) << " (Expected 5)\n";
+    expect(shadowFused.size() == 3 && std::get<double>(shadowResult.getData(0)) == 5.0, "Fusion skipped when b writes a column of a");
+
+    // a constant expression has no column to take its row count from
+    bool constantRejected = false;
+    try {
+        makeExpressionNode("y", "2 * 3");
+    } catch (const std::invalid_argument& error) {
+        std::cout << "  " << error.what() << "\n";
+        constantRejected = true;
+    }
+    expect(constantRejected, "Rejects a node without columns");
+
+    // nulls: rows null in any column are null in the result, across chunk and word boundaries
+    MiniBatch nullableX;
+    MiniBatch nullableY;
+    for (size_t i = 0; i < 130; ++i) {
+        if (i == 3 || i == 64 || i == 129) {
+            nullableX.addNull();
+        } else {
+            nullableX.addData(static_cast<double>(i));
+        }
+        nullableY.addData(1.0);
+    }
+    nullableY.setValid(70, false);
+    nullableY.setValid(70, true);
+    nullableY.setValid(71, false);
+    MiniBatch sums({0.0, 0.0, 0.0, 0.0, 0.0}); // results appended at an offset within the first word
+    Expression("x / y").evaluate({&nullableX, &nullableY}, sums);
+    std::vector<size_t> nulls;
+    for (size_t i = 0; i < sums.size(); ++i) {
+        if (!sums.isValid(i)) {
+            nulls.push_back(i);
+        }
+    }
+    std::cout << "Null rows: " << sums.nullCount() << " (Expected 4)\n";
+    expect(sums.size() == 135 && nulls == std::vector<size_t>{8, 69, 76, 134}
+               && std::get<double>(sums.getData(5 + 128)) == 128.0,
+           "Null rows propagated by an expression");
+
+    // an element-wise node is not called for null elements, which stay null downstream
+    Graph nullGraph;
+    size_t doubledId = nullGraph.addNode(makeExpressionNode("d", "x * 2"));
+    size_t calls = 0;
+    GraphNode increment(ComputeType::CPU, [&calls](auto& inputs, auto& outputs) {
+        ++calls;
+        outputs["e"] = std::get<double>(inputs["d"]) + 1;
+    });
+    increment.addInput("d", DataContainer());
+    increment.setInputType("d", fieldTypeOf<double>());
+    increment.addOutput("e", DataContainer());
+    size_t incrementId = nullGraph.addNode(increment);
+    nullGraph.addEdge(doubledId, incrementId);
+    std::vector<std::unordered_map<std::string, MiniBatch>> nullInputs(1);
+    nullInputs[0]["x"] = nullableX;
+    Executor nullExecutor(nullGraph, nullInputs);
+    nullExecutor.setExecutionMode(ExecutionMode::Inline);
+    nullExecutor.run();
+    const MiniBatch& incremented = nullGraph.getMiniBatch(incrementId, 0, "e");
+    expect(calls == 127 && incremented.size() == 130 && incremented.nullCount() == 3 && !incremented.isValid(64)
+               && std::get<double>(incremented.getData(65)) == 131.0,
+           "Null elements skipped by an element-wise node");
+
+    // a whole word of nulls is skipped at once, and recordings keep the nulls of their inputs
+    Graph wideGraph;
+    size_t wideId = wideGraph.addNode(increment);
+    MiniBatch wide;
+    for (size_t i = 0; i < 200; ++i) {
+        wide.addData(static_cast<double>(i));
+    }
+    for (size_t i = 64; i < 128; ++i) {
+        wide.setValid(i, false);
+    }
+    wide.setValid(150, false);
+    std::vector<std::unordered_map<std::string, MiniBatch>> wideInputs(1);
+    wideInputs[0]["d"] = wide;
+    Recording wideRecording;
+    Executor wideExecutor(wideGraph, wideInputs);
+    wideExecutor.setExecutionMode(ExecutionMode::Inline);
+    wideExecutor.setRecording(&wideRecording);
+    calls = 0;
+    wideExecutor.run();
+    const MiniBatch& wideResult = wideGraph.getMiniBatch(wideId, 0, "e");
+    std::stringstream wideFile;
+    wideRecording.save(wideFile);
+    MiniBatch replayed = Recording::load(wideFile).inputBatches()[0]["d"];
+    std::cout << "Nulls after a null word: " << wideResult.nullCount() << " (Expected 65)\n";
+    expect(calls == 135 && wideResult.size() == 200 && wideResult.nullCount() == 65 && !wideResult.isValid(150)
+               && std::get<double>(wideResult.getData(128)) == 129.0,
+           "Null words skipped by an element-wise node");
+    expect(replayed.size() == 200 && replayed.nullCount() == 65 && !replayed.isValid(64) && replayed.isValid(128),
+           "Nulls kept by a recording");
+
+    std::cout << "Expression failures: " << failures << "\n";
+    return failures == 0 ? 0 : 1;
+}
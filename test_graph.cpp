@@ -1,37 +1,498 @@
-#include <iostream>
-
-#include "graph.h"
-
-int main() {
-    Graph graph;
-
-    GraphNode nodeA(ComputeType::CPU);
-    nodeA.addOutput("dataA", DataContainer(0));
-    nodeA.addInput("dataC", DataContainer(0)); // Intentionally mismatched for testing
-
-    GraphNode nodeB(ComputeType::CPU);
-    nodeB.addOutput("dataB", DataContainer(0));
-    nodeB.addInput("dataA", DataContainer(0));
-
-    GraphNode nodeC(ComputeType::CPU);
-    nodeC.addOutput("dataC", DataContainer(0));
-    nodeC.addInput("dataB", DataContainer(0));
-
-    size_t idA = graph.addNode(nodeA);
-    size_t idB = graph.addNode(nodeB);
-    size_t idC = graph.addNode(nodeC);
-
-    graph.printRoots();
-
-    std::cout << "hasCycle: " << (graph.hasCycle() ? "true" : "false") << "\n";
-
-    std::cout << "Adding edge A -> B: " << (graph.addEdge(idA, idB) ? "Success" : "Failed") << "\n";
-    std::cout << "Adding edge B -> C: " << (graph.addEdge(idB, idC) ? "Success" : "Failed") << "\n";
-    std::cout << "Adding edge C -> A: " << (graph.addEdge(idC, idA) ? "Success" : "Failed (Expected, creates a cycle)") << "\n";
-    
-    graph.printRoots();
-
-    graph.printGraph();
-
-    return 0;
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include "dag.h"
+#include "replay.h"
+
+int main() {
+    Graph graph;
+
+    GraphNode nodeA(ComputeType::CPU);
+    nodeA.addOutput("dataA", DataContainer(0));
+    nodeA.addInput("dataC", DataContainer(0)); // Intentionally mismatched for testing
+
+    GraphNode nodeB(ComputeType::CPU);
+    nodeB.addOutput("dataB", DataContainer(0));
+    nodeB.addInput("dataA", DataContainer(0));
+
+    GraphNode nodeC(ComputeType::CPU);
+    nodeC.addOutput("dataC", DataContainer(0));
+    nodeC.addInput("dataB", DataContainer(0));
+
+    size_t idA = graph.addNode(nodeA);
+    size_t idB = graph.addNode(nodeB);
+    size_t idC = graph.addNode(nodeC);
+
+    graph.printRoots();
+
+    std::cout << "hasCycle: " << (graph.hasCycle() ? "true" : "false") << "\n";
+
+    std::cout << "Adding edge A -> B: " << (graph.addEdge(idA, idB) ? "Success" : "Failed") << "\n";
+    std::cout << "Adding edge B -> C: " << (graph.addEdge(idB, idC) ? "Success" : "Failed") << "\n";
+    std::cout << "Adding edge C -> A: " << (graph.addEdge(idC, idA) ? "Success" : "Failed (Expected, creates a cycle)") << "\n";
+    
+    graph.printRoots();
+
+    graph.printGraph();
+
+    // typed ports: a double output feeding a std::vector<int> input, and an input nobody produces
+    Graph typed;
+    GraphNode producer(ComputeType::CPU);
+    producer.addInput("in", DataContainer());
+    producer.setInputType("in", fieldTypeOf<double>());
+    producer.addOutput("values", DataContainer());
+    producer.setOutputType("values", fieldTypeOf<double>());
+
+    GraphNode consumer(ComputeType::CPU);
+    consumer.addInput("values", DataContainer());
+    consumer.setInputType("values", fieldTypeOf<std::vector<int>>());
+    consumer.addInput("weights", DataContainer());
+    consumer.addOutput("sum", DataContainer());
+
+    size_t idProducer = typed.addNode(producer);
+    size_t idConsumer = typed.addNode(consumer);
+    typed.addEdge(idProducer, idConsumer);
+
+    std::vector<std::string> problems = typed.validate();
+    for (const auto& problem : problems) {
+        std::cout << problem << "\n";
+    }
+    std::cout << "Problems found: " << problems.size() << " (Expected 2)\n";
+
+    bool compileRejected = false;
+    try {
+        typed.compile();
+    } catch (const std::logic_error&) {
+        compileRejected = true;
+    }
+    std::cout << "Compile rejected: " << compileRejected << " (Expected 1)\n";
+
+    typed.getNode(idConsumer).setInputType("values", fieldTypeOf<double>());
+    typed.getNode(idConsumer).setInputOptional("weights");
+    size_t problemsAfterFix = typed.validate().size();
+    std::cout << "Problems after fix: " << problemsAfterFix << " (Expected 0)\n";
+
+    // the input batches of root nodes are checked once before the run
+    std::vector<std::unordered_map<std::string, MiniBatch>> wrongInputs = {{{"in", MiniBatch({1.0, 2, 3.0})}}};
+    bool inputsRejected = false;
+    try {
+        Executor executor(typed, wrongInputs);
+    } catch (const std::invalid_argument& e) {
+        std::cout << e.what() << "\n";
+        inputsRejected = true;
+    }
+    std::cout << "Input batches rejected: " << inputsRejected << " (Expected 1)\n";
+
+    // explicit port edge: only "doubled" moves, renamed to "x"; "offset" matches by name but isn't connected
+    Graph ports;
+    GraphNode source(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        outputs["doubled"] = std::get<double>(inputs["in"]) * 2;
+        outputs["offset"] = std::get<double>(inputs["in"]) + 100;
+    });
+    source.addInput("in", DataContainer());
+    source.addOutput("doubled", DataContainer());
+    source.addOutput("offset", DataContainer());
+
+    GraphNode sink(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        outputs["result"] = std::get<double>(inputs["x"]) + 1;
+    });
+    sink.addInput("x", DataContainer());
+    sink.addInput("offset", DataContainer());
+    sink.setInputOptional("offset");
+    sink.addOutput("result", DataContainer());
+
+    size_t idSource = ports.addNode(source);
+    size_t idSink = ports.addNode(sink);
+    bool connected = ports.addEdge(idSource, "doubled", idSink, "x");
+    bool unknownPortRejected = !ports.addEdge(idSource, "missing", idSink, "x");
+
+    std::vector<std::unordered_map<std::string, MiniBatch>> portInputs = {{{"in", MiniBatch({1.0, 2.0})}}};
+    Executor portExecutor(ports, portInputs);
+    portExecutor.run();
+    const MiniBatch& result = ports.getMiniBatch(idSink, 0, "result");
+    bool portsMatch = connected && unknownPortRejected && result.size() == 2
+        && std::get<double>(result.getData(0)) == 3.0 && std::get<double>(result.getData(1)) == 5.0
+        && ports.getMiniBatch(idSink, 0, "offset").size() == 0
+        && portExecutor.getStats().edgeBytes.at({idSource, idSink}) == 2 * sizeof(DataContainer);
+    std::cout << "Port edge passes only the connected field: " << portsMatch << " (Expected 1)\n";
+
+    // autotuning calibrates once per workload, a second tuner reuses the configuration from the file
+    const std::string tunePath = "autotune_test.txt";
+    std::remove(tunePath.c_str());
+    std::vector<std::unordered_map<std::string, MiniBatch>> tuneInputs(4, {{"in", MiniBatch({1.0, 2.0, 3.0})}});
+    AutoTuner tuner(tunePath);
+    tuner.setRepetitions(1);
+    tuner.setMaxThreads(4);
+    TunedConfig tuned = tuner.tune(ports, tuneInputs);
+    size_t firstRuns = tuner.calibrationRuns();
+    AutoTuner reloaded(tunePath);
+    TunedConfig reused = reloaded.tune(ports, tuneInputs);
+    tuneInputs.resize(64, tuneInputs[0]);
+    bool otherShapeDiffers = AutoTuner::hash(ports, tuneInputs) != AutoTuner::hash(ports, portInputs);
+    bool tunedOnce = firstRuns > 0 && reloaded.calibrationRuns() == 0 && reused.numThreads == tuned.numThreads
+        && reused.prefetchLimit == tuned.prefetchLimit && reused.grainSeconds == tuned.grainSeconds && otherShapeDiffers;
+    // files written before the grain was tuned read with no coarsening
+    std::istringstream legacyFile("dag-autotune 1\nconfigs 1\nconfig 2a 4 65536 0.5\n");
+    std::ostringstream upgradedFile;
+    AutoTuner legacy;
+    legacy.load(legacyFile);
+    legacy.save(upgradedFile);
+    tunedOnce = tunedOnce && upgradedFile.str() == "dag-autotune 2\nconfigs 1\nconfig 2a 4 65536 0 0.5\n";
+    std::remove(tunePath.c_str());
+    std::cout << "Autotuned " << tuned.numThreads << " threads in " << firstRuns << " runs, reused from file: "
+              << tunedOnce << " (Expected 1)\n";
+
+    // the detected worker count stays within the machine, DAG_NUM_THREADS overrides it
+    ConcurrencyInfo concurrency = detectConcurrency();
+    setenv("DAG_NUM_THREADS", "3", 1);
+    size_t overridden = detectConcurrency().workers;
+    unsetenv("DAG_NUM_THREADS");
+    bool concurrencyDetected = concurrency.workers >= 1 && concurrency.workers <= concurrency.hardwareThreads
+        && overridden == 3 && Executor(ports, portInputs).getNumThreads() == defaultWorkerCount();
+    std::cout << "Workers: " << concurrency.workers << " of " << concurrency.hardwareThreads << " hardware threads, "
+              << concurrency.affinityCpus << " in the affinity mask, cgroup quota " << concurrency.cgroupCpus
+              << " CPUs, override honored: " << concurrencyDetected << " (Expected 1)\n";
+
+    // hardware counters, where the PMU is accessible, are attributed to every node of both execution modes
+    bool countersConsistent = true;
+    for (ExecutionMode mode : {ExecutionMode::Inline, ExecutionMode::Parallel}) {
+        Executor countedExecutor(ports, tuneInputs);
+        countedExecutor.setExecutionMode(mode);
+        countedExecutor.setHardwareCounters(true);
+        countedExecutor.run();
+        const ExecutorStats& countedStats = countedExecutor.getStats();
+        for (const auto& nodeStats : countedStats.nodes) {
+            countersConsistent = countersConsistent && nodeStats.invocations == tuneInputs.size()
+                && (countedStats.hardwareCounters ? nodeStats.counters.instructions > 0 && nodeStats.countedElements > 0
+                                                  : nodeStats.counters.cycles == 0);
+        }
+        std::cout << "Hardware counters available: " << countedStats.hardwareCounters << ", source IPC "
+                  << countedStats.nodes[idSource].instructionsPerCycle() << "\n";
+    }
+    std::cout << "Hardware counters consistent: " << countersConsistent << " (Expected 1)\n";
+
+    // coarsening: a cheap diamond becomes one cluster, an expensive node and the node after it stay alone
+    Graph diamond;
+    auto addStage = [&diamond](std::vector<std::string> inputs, const std::string& output) {
+        GraphNode node(ComputeType::CPU, [output](auto&, auto& outputs) { outputs[output] = 1.0; });
+        for (const auto& input : inputs) {
+            node.addInput(input, DataContainer());
+        }
+        node.addOutput(output, DataContainer());
+        return diamond.addNode(node);
+    };
+    size_t idTop = addStage({"in"}, "x");
+    size_t idLeft = addStage({"x"}, "y");
+    size_t idRight = addStage({"x"}, "z");
+    size_t idJoin = addStage({"y", "z"}, "w");
+    size_t idHeavy = addStage({"w"}, "v");
+    size_t idTail = addStage({"v"}, "u");
+    diamond.addEdge(idTop, idLeft);
+    diamond.addEdge(idTop, idRight);
+    diamond.addEdge(idLeft, idJoin);
+    diamond.addEdge(idRight, idJoin);
+    diamond.addEdge(idJoin, idHeavy);
+    diamond.addEdge(idHeavy, idTail);
+    diamond.compile();
+    TaskClusters clusters = diamond.coarsen({0.2, 0.2, 0.2, 0.2, 5.0, 0.2}, 1.0);
+    bool coarsened = clusters.members.size() == 3
+        && clusters.members[0] == std::vector<size_t>({idTop, idLeft, idRight, idJoin}) && clusters.isHead(idTop)
+        && !clusters.isHead(idJoin) && clusters.members[1] == std::vector<size_t>({idHeavy})
+        && clusters.members[2] == std::vector<size_t>({idTail})
+        && diamond.coarsen({0.2, 0.2, 0.2, 0.2, 5.0, 0.2}, 0.5).members.size() == 5;
+    std::cout << "Coarsened into " << clusters.members.size() << " clusters: " << coarsened << " (Expected 1)\n";
+
+    // transitive reduction drops the implied ordering edges, keeps the others and every data edge
+    diamond.addOrderingEdge(idTop, idJoin);
+    diamond.addOrderingEdge(idTop, idTail);
+    diamond.addOrderingEdge(idLeft, idRight);
+    diamond.compile();
+    size_t reducedEdges = diamond.reduceTransitiveEdges();
+    bool reduced = reducedEdges == 2 && diamond.isCompiled() && !diamond.edgeExists(idTop, idJoin)
+        && !diamond.edgeExists(idTop, idTail) && diamond.edgeExists(idLeft, idRight)
+        && diamond.getEdgePorts(idLeft, idRight).empty() && diamond.edgeExists(idTop, idRight)
+        && diamond.getPredecessors(idRight).size() == 2 && diamond.reduceTransitiveEdges() == 0;
+    std::vector<std::unordered_map<std::string, MiniBatch>> diamondInputs(1, {{"in", MiniBatch({1.0, 2.0})}});
+    Executor diamondExecutor(diamond, diamondInputs);
+    diamondExecutor.setExecutionMode(ExecutionMode::Parallel);
+    diamondExecutor.run();
+    reduced = reduced && diamond.getMiniBatch(idTail, 0, "u").size() == 4; // the join processes both inputs
+    std::cout << "Transitive reduction removed " << reducedEdges << " edges: " << reduced << " (Expected 1)\n";
+
+    // the builder reproduces the diamond in one pass, and reports every cycle and invalid edge at once
+    GraphBuilder builder;
+    builder.reserve(diamond.size(), 8);
+    for (size_t nodeId = 0; nodeId < diamond.size(); ++nodeId) {
+        builder.addNode(diamond.getNode(nodeId));
+    }
+    builder.addEdges({{idTop, idLeft}, {idTop, idRight}, {idLeft, idJoin}, {idRight, idJoin}, {idJoin, idHeavy}});
+    builder.addEdge(idHeavy, "v", idTail, "v");
+    builder.addOrderingEdge(idLeft, idRight);
+    builder.addOrderingEdge(idTop, idLeft); // merged into the data edge
+    Graph built = builder.build();
+    built.compile();
+    bool builtSame = builder.size() == 0 && built.size() == diamond.size() && built.getRootNodes() == diamond.getRootNodes()
+        && built.getTopologicalOrder() == diamond.getTopologicalOrder() && built.getEdgePorts(idLeft, idRight).empty()
+        && built.getEdgePorts(idTop, idLeft).size() == 1 && built.getEdgePorts(idHeavy, idTail).size() == 1;
+    for (size_t from = 0; from < diamond.size(); ++from) {
+        for (size_t to = 0; to < diamond.size(); ++to) {
+            builtSame = builtSame && built.edgeExists(from, to) == diamond.edgeExists(from, to);
+        }
+    }
+
+    GraphBuilder cyclic;
+    for (size_t nodeId = 0; nodeId < diamond.size(); ++nodeId) {
+        cyclic.addNode(diamond.getNode(nodeId));
+    }
+    cyclic.addOrderingEdge(0, 1);
+    cyclic.addOrderingEdge(1, 2);
+    cyclic.addOrderingEdge(2, 0);
+    cyclic.addOrderingEdge(3, 4);
+    cyclic.addOrderingEdge(4, 3);
+    cyclic.addOrderingEdge(5, 5);
+    cyclic.addEdge(0, 42);
+    cyclic.addEdge(idTop, "x", idTail, "missing");
+    std::vector<std::vector<size_t>> cycles = cyclic.findCycles();
+    bool allReported = false;
+    try {
+        cyclic.build();
+    } catch (const std::logic_error& e) {
+        allReported = std::string(e.what()).find("Cycle 0 -> 1 -> 2 -> 0.") != std::string::npos
+            && std::string(e.what()).find("Cycle 5 -> 5.") != std::string::npos;
+    }
+    bool builderWorks = builtSame && cycles.size() == 3 && cyclic.validate().size() == 5 && allReported;
+    std::cout << "Builder matches incremental graph, " << cycles.size() << " cycles reported: " << builderWorks
+              << " (Expected 1)\n";
+
+    // a node splits its batch into partitions run by the executor's workers, with nested groups and errors
+    GraphNode partitioned(ComputeType::CPU);
+    partitioned.addInput("in", DataContainer());
+    partitioned.addOutput("squares", DataContainer());
+    partitioned.setColumnProcess([](const std::map<std::string, const MiniBatch*>& inputs,
+                                    std::map<std::string, MiniBatch*>& outputs) {
+        const MiniBatch& in = *inputs.at("in");
+        MiniBatchData& out = outputs.at("squares")->getData();
+        out.resize(in.size());
+        const size_t partitions = 8;
+        TaskGroup group;
+        for (size_t p = 0; p < partitions; ++p) {
+            group.run([&in, &out, p, partitions] {
+                size_t begin = in.size() * p / partitions;
+                size_t end = in.size() * (p + 1) / partitions;
+                TaskGroup halves;
+                halves.run([&, begin, end] {
+                    for (size_t i = begin; i < (begin + end) / 2; ++i) {
+                        double x = std::get<double>(in.getData(i));
+                        out[i] = x * x;
+                    }
+                });
+                for (size_t i = (begin + end) / 2; i < end; ++i) {
+                    double x = std::get<double>(in.getData(i));
+                    out[i] = x * x;
+                }
+                halves.wait();
+            });
+        }
+        group.wait();
+    });
+    bool childrenJoined = true;
+    for (ExecutionMode mode : {ExecutionMode::Inline, ExecutionMode::Parallel}) {
+        Graph spawning;
+        size_t idPartitioned = spawning.addNode(partitioned);
+        MiniBatch values;
+        for (size_t i = 0; i < 1000; ++i) {
+            values.addData(static_cast<double>(i));
+        }
+        std::vector<std::unordered_map<std::string, MiniBatch>> spawnInputs(3, {{"in", values}});
+        Executor spawnExecutor(spawning, spawnInputs);
+        spawnExecutor.setExecutionMode(mode);
+        spawnExecutor.setNumThreads(4);
+        spawnExecutor.run();
+        for (size_t batchId = 0; batchId < spawnInputs.size(); ++batchId) {
+            const MiniBatch& squares = spawning.getMiniBatch(idPartitioned, batchId, "squares");
+            childrenJoined = childrenJoined && squares.size() == 1000;
+            for (size_t i = 0; childrenJoined && i < squares.size(); ++i) {
+                childrenJoined = std::get<double>(squares.getData(i)) == static_cast<double>(i * i);
+            }
+        }
+    }
+    bool childErrorRethrown = false;
+    try {
+        TaskGroup failing;
+        failing.run([] { throw std::runtime_error("child failed"); });
+        failing.wait();
+    } catch (const std::runtime_error&) {
+        childErrorRethrown = true;
+    }
+    bool taskGroups = childrenJoined && childErrorRethrown;
+    std::cout << "Task groups joined their children: " << taskGroups << " (Expected 1)\n";
+
+    // Newton's method for square roots as a loop node, iterating until convergence or the cap
+    Graph newton;
+    size_t idStep = newton.addNode(makeExpressionNode("next", "0.5 * (x + a / x)"));
+    LoopSpec loop;
+    loop.feedback.push_back(LoopFeedback{idStep, "next", "x"});
+    loop.outputs["root"] = LoopFeedback{idStep, "next", ""};
+    loop.maxIterations = 50;
+    LoopCondition within = convergedWithin(1e-12);
+    std::atomic<size_t> longestLoop{0};
+    loop.converged = [&](size_t iteration, const auto& previous, const auto& next) {
+        size_t longest = longestLoop.load();
+        while (iteration > longest && !longestLoop.compare_exchange_weak(longest, iteration)) {
+        }
+        return within(iteration, previous, next);
+    };
+    bool badSpecRejected = false;
+    try {
+        LoopSpec badSpec;
+        badSpec.feedback.push_back(LoopFeedback{idStep, "next", "missing"});
+        makeLoopNode(newton, badSpec);
+    } catch (const std::invalid_argument&) {
+        badSpecRejected = true;
+    }
+    Graph looping;
+    size_t idLoop = looping.addNode(makeLoopNode(newton, loop));
+    std::vector<std::unordered_map<std::string, MiniBatch>> loopInputs(8);
+    for (size_t batchId = 0; batchId < loopInputs.size(); ++batchId) {
+        loopInputs[batchId]["a"] = MiniBatch({2.0, 9.0, 1e6 + static_cast<double>(batchId)});
+        loopInputs[batchId]["x"] = MiniBatch({1.0, 1.0, 1.0});
+    }
+    Executor loopExecutor(looping, loopInputs);
+    loopExecutor.setExecutionMode(ExecutionMode::Parallel);
+    loopExecutor.setNumThreads(4);
+    loopExecutor.run();
+    bool loopConverged = badSpecRejected && longestLoop.load() > 2 && longestLoop.load() < 50;
+    for (size_t batchId = 0; batchId < loopInputs.size(); ++batchId) {
+        const MiniBatch& roots = looping.getMiniBatch(idLoop, batchId, "root");
+        for (size_t i = 0; loopConverged && i < roots.size(); ++i) {
+            double a = std::get<double>(loopInputs[batchId]["a"].getData(i));
+            loopConverged = std::fabs(std::get<double>(roots.getData(i)) - std::sqrt(a)) < 1e-9;
+        }
+        loopConverged = loopConverged && roots.size() == 3;
+    }
+    // without a condition the loop runs up to the cap: 3 steps from 1 toward sqrt(2)
+    loop.converged = LoopCondition();
+    loop.maxIterations = 3;
+    Graph capped;
+    size_t idCapped = capped.addNode(makeLoopNode(newton, loop));
+    std::vector<std::unordered_map<std::string, MiniBatch>> cappedInputs(1, {{"a", MiniBatch({2.0})}, {"x", MiniBatch({1.0})}});
+    Executor cappedExecutor(capped, cappedInputs);
+    cappedExecutor.run();
+    loopConverged = loopConverged
+        && std::fabs(std::get<double>(capped.getMiniBatch(idCapped, 0, "root").getData(0)) - 577.0 / 408.0) < 1e-15;
+    // feedback of another declared type is rejected once, instead of checked by every iteration
+    Graph mistyped;
+    size_t idMistyped = mistyped.addNode(makeExpressionNode("next", "x / 2"));
+    mistyped.getNode(idMistyped).setInputType("x", fieldTypeOf<int>());
+    LoopSpec mistypedLoop;
+    mistypedLoop.feedback.push_back(LoopFeedback{idMistyped, "next", "x"});
+    bool mistypedRejected = false;
+    try {
+        makeLoopNode(mistyped, mistypedLoop);
+    } catch (const std::invalid_argument& error) {
+        std::cout << error.what() << "\n";
+        mistypedRejected = true;
+    }
+    // reset(false) only checks that the fields are present
+    Graph typedRoot;
+    typedRoot.addNode(makeExpressionNode("y", "x + 1"));
+    typedRoot.getNode(0).setInputType("x", fieldTypeOf<double>());
+    std::vector<std::unordered_map<std::string, MiniBatch>> typedRootInputs(1, {{"x", MiniBatch({1.0})}});
+    Executor typedRootExecutor(typedRoot, typedRootInputs);
+    typedRootInputs[0]["x"].addData(2);
+    bool resetValidation = true;
+    typedRootExecutor.reset(false);
+    try {
+        typedRootExecutor.reset();
+        resetValidation = false;
+    } catch (const std::invalid_argument&) {
+    }
+    loopConverged = loopConverged && mistypedRejected && resetValidation;
+    std::cout << "Loop node converged in at most " << longestLoop.load() << " iterations: " << loopConverged
+              << " (Expected 1)\n";
+
+    // a schedule must hold every task exactly once
+    Graph scheduled;
+    GraphNode first(ComputeType::CPU, [](auto& inputs, auto& outputs) { outputs["x"] = std::get<double>(inputs["in"]) * 2; });
+    first.addInput("in", DataContainer());
+    first.addOutput("x", DataContainer());
+    GraphNode second(ComputeType::CPU, [](auto& inputs, auto& outputs) { outputs["y"] = std::get<double>(inputs["x"]) + 1; });
+    second.addInput("x", DataContainer());
+    second.addOutput("y", DataContainer());
+    size_t idFirst = scheduled.addNode(first);
+    size_t idSecond = scheduled.addNode(second);
+    scheduled.addEdge(idFirst, idSecond);
+    std::vector<std::unordered_map<std::string, MiniBatch>> scheduledInputs(2, {{"in", MiniBatch({1.0, 2.0})}});
+    Executor scheduledExecutor(scheduled, scheduledInputs);
+    size_t schedulesRejected = 0;
+    for (const auto& schedule : std::vector<std::vector<ScheduleStep>>{
+             {{idFirst, 0}, {idFirst, 0}, {idSecond, 0}, {idSecond, 1}}, {{idFirst, 0}, {idFirst, 1}, {idSecond, 0}, {idSecond, 2}},
+             {{idFirst, 0}, {idSecond, 0}, {7, 1}, {idSecond, 1}}}) {
+        try {
+            scheduledExecutor.setSchedule(schedule);
+        } catch (const std::invalid_argument& error) {
+            std::cout << error.what() << "\n";
+            schedulesRejected++;
+        }
+    }
+    std::cout << "Invalid schedules rejected: " << schedulesRejected << " (Expected 3)\n";
+    // a reversed schedule is only a priority: inline runs still wait for the inputs
+    scheduledExecutor.setSchedule({{idSecond, 1}, {idSecond, 0}, {idFirst, 1}, {idFirst, 0}});
+    scheduledExecutor.setExecutionMode(ExecutionMode::Inline);
+    scheduledExecutor.run();
+    bool reversedRuns = true;
+    for (size_t batchId = 0; batchId < scheduledInputs.size(); ++batchId) {
+        const MiniBatch& results = scheduled.getMiniBatch(idSecond, batchId, "y");
+        reversedRuns = reversedRuns && results.size() == 2 && std::get<double>(results.getData(1)) == 5.0;
+    }
+    std::cout << "Reversed schedule run inline: " << reversedRuns << " (Expected 1)\n";
+
+    // ordering edges survive a recording and its replay
+    Graph ordered;
+    size_t idProduce = ordered.addNode(first);
+    size_t idConsumeY = ordered.addNode(second);
+    GraphNode third(ComputeType::CPU, [](auto& inputs, auto& outputs) { outputs["z"] = inputs["x"]; });
+    third.addInput("x", DataContainer());
+    third.addOutput("z", DataContainer());
+    size_t idConsumeZ = ordered.addNode(third);
+    ordered.addEdge(idProduce, idConsumeY);
+    ordered.addEdge(idProduce, idConsumeZ);
+    ordered.addOrderingEdge(idConsumeY, idConsumeZ);
+    Recording orderedRecording;
+    Executor orderedExecutor(ordered, scheduledInputs);
+    orderedExecutor.setRecording(&orderedRecording);
+    orderedExecutor.run();
+    std::stringstream recordingFile;
+    orderedRecording.save(recordingFile);
+    Recording reloadedRecording = Recording::load(recordingFile);
+    Graph synthetic = reloadedRecording.syntheticGraph();
+    bool orderingReplayed = synthetic.edgeExists(idConsumeY, idConsumeZ)
+        && synthetic.getEdgePorts(idConsumeY, idConsumeZ).empty()
+        && synthetic.getEdgePorts(idProduce, idConsumeZ).size() == 1;
+    Replayer replayer(reloadedRecording);
+    orderingReplayed = orderingReplayed && replayer.replay(ReplayPolicy::Recorded).nodes.size() == 3;
+    std::cout << "Ordering edge replayed: " << orderingReplayed << " (Expected 1)\n";
+
+    // the tasks run by evaluate() stay in the recording next to those of the following run()
+    Recording partialRecording;
+    Executor partialExecutor(ordered, scheduledInputs);
+    partialExecutor.setRecording(&partialRecording);
+    partialExecutor.evaluate(idConsumeY, "y", 0);
+    partialExecutor.run();
+    bool partialReplayed = partialRecording.tasks.size() == ordered.size() * scheduledInputs.size();
+    try {
+        partialReplayed = partialReplayed && Replayer(partialRecording).replay(ReplayPolicy::Recorded).nodes.size() == 3;
+    } catch (const std::exception& error) {
+        std::cout << error.what() << std::endl;
+        partialReplayed = false;
+    }
+    std::cout << "Recorded tasks after evaluate() and run(): " << partialRecording.tasks.size() << " (Expected 6)\n";
+
+    return problems.size() == 2 && compileRejected && problemsAfterFix == 0 && inputsRejected && portsMatch && tunedOnce
+        && concurrencyDetected && countersConsistent && coarsened && reduced && builderWorks && taskGroups && loopConverged
+        && schedulesRejected == 3 && reversedRuns && orderingReplayed && partialReplayed ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <iostream>
+
+#include "dag.h"
+
+int main() {
+    Graph graph;
+
+    // two independent chains, each expanding "in" into a wide intermediate and reducing it again
+    GraphNode expandX(ComputeType::CPU);
+    expandX.addInput("in", DataContainer());
+    expandX.addOutput("wideX", DataContainer());
+
+    GraphNode expandY(ComputeType::CPU);
+    expandY.addInput("in", DataContainer());
+    expandY.addOutput("wideY", DataContainer());
+
+    GraphNode reduceX(ComputeType::CPU);
+    reduceX.addInput("wideX", DataContainer());
+    reduceX.addOutput("sumX", DataContainer());
+
+    GraphNode reduceY(ComputeType::CPU);
+    reduceY.addInput("wideY", DataContainer());
+    reduceY.addOutput("sumY", DataContainer());
+
+    size_t idExpandX = graph.addNode(expandX);
+    size_t idExpandY = graph.addNode(expandY);
+    size_t idReduceX = graph.addNode(reduceX);
+    size_t idReduceY = graph.addNode(reduceY);
+    graph.addEdge(idExpandX, idReduceX);
+    graph.addEdge(idExpandY, idReduceY);
+
+    graph.compile();
+
+    std::cout << "Topological order: ";
+    for (size_t nodeId : graph.getTopologicalOrder()) {
+        std::cout << nodeId << " ";
+    }
+    std::cout << "\n";
+
+    FieldSizes fieldSizes = {{"in", 8}, {"wideX", 64}, {"wideY", 64}, {"sumX", 1}, {"sumY", 1}};
+    std::vector<size_t> batchSizes = {10};
+
+    MemoryEstimate topological = graph.estimatePeakMemory(fieldSizes, batchSizes);
+    std::cout << "Peak bytes (topological order): " << topological.peakBytes << " (Expected 1360)\n";
+
+    MemoryPlan plan = graph.planMemory(fieldSizes, batchSizes);
+    std::cout << "Planned order: ";
+    for (const auto& step : plan.schedule) {
+        std::cout << step.first << " ";
+    }
+    std::cout << "\n";
+    std::cout << "Peak bytes (planned order): " << plan.estimate.peakBytes << " (Expected 800)\n";
+
+    // a field read through two ports of the same consumer dies with that consumer
+    Graph twoPorts;
+    GraphNode source(ComputeType::CPU);
+    source.addInput("in", DataContainer());
+    source.addOutput("v", DataContainer());
+    GraphNode pair(ComputeType::CPU);
+    pair.addInput("a", DataContainer());
+    pair.addInput("b", DataContainer());
+    pair.addOutput("out", DataContainer());
+    GraphNode last(ComputeType::CPU);
+    last.addInput("out", DataContainer());
+    last.addOutput("res", DataContainer());
+    size_t idSource = twoPorts.addNode(source);
+    size_t idPair = twoPorts.addNode(pair);
+    size_t idLast = twoPorts.addNode(last);
+    twoPorts.addEdge(idSource, "v", idPair, "a");
+    twoPorts.addEdge(idSource, "v", idPair, "b");
+    twoPorts.addEdge(idPair, idLast);
+    twoPorts.compile();
+    FieldSizes twoPortSizes = {{"in", 8}, {"v", 8}, {"out", 8}, {"res", 8}};
+    size_t twoPortPeak = twoPorts.estimatePeakMemory(twoPortSizes, batchSizes).peakBytes;
+    std::cout << "Peak bytes (field read through two ports): " << twoPortPeak << " (Expected 160)\n";
+
+    // chain of element-wise nodes sharing buffers between non-overlapping fields
+    Graph chain;
+    chain.setBufferReuse(true);
+    std::vector<size_t> chainIds;
+    for (int stage = 0; stage < 4; ++stage) {
+        std::string in = "stage" + std::to_string(stage);
+        std::string out = "stage" + std::to_string(stage + 1);
+        GraphNode stageNode(ComputeType::CPU, [in, out](auto& inputs, auto& outputs) {
+            outputs[out] = std::get<double>(inputs[in]) + 1;
+        });
+        stageNode.addInput(in, DataContainer());
+        stageNode.addOutput(out, DataContainer());
+        stageNode.setInPlace(in, out); // element-wise, the output may overwrite the input
+        chainIds.push_back(chain.addNode(stageNode));
+        if (stage > 0) {
+            chain.addEdge(chainIds[stage - 1], chainIds[stage]);
+        }
+    }
+    chain.compile();
+    size_t numBuffers = chain.getBufferAssignment().numBuffers;
+    std::cout << "Physical buffers for 8 MiniBatches: " << numBuffers << " (Expected 3)\n";
+
+    std::vector<std::unordered_map<std::string, MiniBatch>> chainInputs = {
+        {{"stage0", MiniBatch({1.0, 2.0, 3.0})}},
+        {{"stage0", MiniBatch({10.0, 20.0})}}
+    };
+    Executor executor(chain, chainInputs);
+    executor.run();
+
+    bool outputsMatch = true;
+    for (size_t batchId = 0; batchId < chainInputs.size(); ++batchId) {
+        const auto& input = chainInputs[batchId].at("stage0");
+        const auto& output = chain.getMiniBatch(chainIds.back(), batchId, "stage4");
+        std::cout << "Batch " << batchId << " output: ";
+        for (size_t i = 0; i < output.size(); ++i) {
+            std::cout << std::get<double>(output.getData(i)) << " ";
+        }
+        std::cout << "\n";
+        outputsMatch = outputsMatch && output.size() == input.size();
+        for (size_t i = 0; outputsMatch && i < output.size(); ++i) {
+            outputsMatch = std::get<double>(output.getData(i)) == std::get<double>(input.getData(i)) + 4;
+        }
+    }
+
+    // large buffers backed by transparent huge pages, every buffer aligned for SIMD loads
+    BufferPages::setPolicy(HugePagePolicy::Transparent, 1024 * 1024);
+    MiniBatch large;
+    for (int i = 0; i < 100000; ++i) {
+        large.addData(static_cast<double>(i));
+    }
+    MiniBatch small({1.0});
+    bool aligned = reinterpret_cast<std::uintptr_t>(large.getData().data()) % BufferPages::alignment == 0
+        && reinterpret_cast<std::uintptr_t>(small.getData().data()) % BufferPages::alignment == 0;
+    std::cout << "Buffers aligned to " << BufferPages::alignment << " bytes: " << aligned << " (Expected 1)\n";
+
+    Graph single;
+    GraphNode copy(ComputeType::CPU, [](auto& inputs, auto& outputs) {
+        outputs["out"] = inputs["in"];
+    });
+    copy.addInput("in", DataContainer());
+    copy.addOutput("out", DataContainer());
+    size_t copyId = single.addNode(copy);
+    std::vector<std::unordered_map<std::string, MiniBatch>> largeInputs = {{{"in", large}}};
+    Executor largeExecutor(single, largeInputs);
+    largeExecutor.run();
+    size_t pageSize = largeExecutor.getStats().pageSize;
+    std::cout << "Page size of large buffers: " << pageSize << "\n";
+    bool largeMatches = single.getMiniBatch(copyId, 0, "out").size() == large.size() && pageSize >= 4096;
+
+    // an executor without large buffers reports regular pages, whatever other executors obtained
+    Graph smallGraph;
+    smallGraph.addNode(copy);
+    std::vector<std::unordered_map<std::string, MiniBatch>> smallInputs = {{{"in", small}}};
+    Executor smallExecutor(smallGraph, smallInputs);
+    smallExecutor.run();
+    size_t smallPageSize = smallExecutor.getStats().pageSize;
+    std::cout << "Page size of small buffers: " << smallPageSize << " (Expected " << BufferPages::pageSize(nullptr) << ")\n";
+    largeMatches = largeMatches && smallPageSize == BufferPages::pageSize(nullptr);
+    BufferPages::setPolicy(HugePagePolicy::None);
+
+    return aligned && largeMatches && topological.peakBytes == 1360 && twoPortPeak == 160 && plan.estimate.peakBytes == 800 && numBuffers == 3 && outputsMatch ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+#include <iostream>
+#include <random>
+
+#include "dag.h"
+
+// Random DAG: node i writes "f<i>" and reads the fields of its predecessors, roots read "in".
+// Edges only go from lower to higher IDs, so the node IDs are a topological order.
+struct RandomDag {
+    Graph graph;
+    std::vector<std::vector<size_t>> predecessors;
+};
+
+static RandomDag buildRandomDag(std::mt19937& rng, size_t numNodes, bool bufferReuse) {
+    RandomDag dag;
+    dag.graph.setBufferReuse(bufferReuse);
+    dag.predecessors.resize(numNodes);
+
+    size_t joins = 0; // nodes with two inputs double the elements, keep the growth bounded
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        std::uniform_int_distribution<int> kind(0, 9);
+        int k = nodeId == 0 ? 0 : kind(rng);
+        if (k >= 2 || (k == 1 && joins >= 3)) {
+            dag.predecessors[nodeId].push_back(std::uniform_int_distribution<size_t>(0, nodeId - 1)(rng));
+        }
+        if (k == 1 && joins < 3 && nodeId >= 2) {
+            std::uniform_int_distribution<size_t> pick(0, nodeId - 1);
+            size_t first = pick(rng);
+            size_t second = pick(rng);
+            while (second == first) {
+                second = pick(rng);
+            }
+            dag.predecessors[nodeId] = {first, second};
+            joins++;
+        }
+
+        std::string output = "f" + std::to_string(nodeId);
+        double scale = static_cast<double>(nodeId % 7 + 1);
+        double offset = static_cast<double>(nodeId);
+        GraphNode node(ComputeType::CPU, [output, scale, offset](auto& inputs, auto& outputs) {
+            double sum = 0;
+            for (const auto& input : inputs) {
+                if (const double* value = std::get_if<double>(&input.second)) {
+                    sum += *value;
+                }
+            }
+            outputs[output] = sum * scale + offset;
+        });
+        if (dag.predecessors[nodeId].empty()) {
+            node.addInput("in", DataContainer());
+        }
+        for (size_t predecessor : dag.predecessors[nodeId]) {
+            node.addInput("f" + std::to_string(predecessor), DataContainer());
+        }
+        node.addOutput(output, DataContainer());
+        if (bufferReuse && dag.predecessors[nodeId].size() <= 1) {
+            node.setInPlace(node.getInputs().begin()->first, output);
+        }
+        dag.graph.addNode(node);
+    }
+
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        for (size_t predecessor : dag.predecessors[nodeId]) {
+            dag.graph.addEdge(predecessor, nodeId);
+        }
+    }
+    return dag;
+}
+
+// Single-threaded reference executor: runs the nodes in ID order with the executor's semantics,
+// every input field is processed in turn, element by element.
+static std::vector<std::vector<double>> referenceRun(RandomDag& dag, const MiniBatch& input) {
+    std::vector<std::vector<double>> results(dag.graph.size());
+    for (size_t nodeId = 0; nodeId < dag.graph.size(); ++nodeId) {
+        const GraphNode& node = dag.graph.getNode(nodeId);
+        std::map<std::string, DataContainer> inputs;
+        std::map<std::string, DataContainer> outputs;
+        for (const auto& inputField : node.getInputs()) {
+            inputs[inputField.first] = DataContainer();
+        }
+        std::string output = "f" + std::to_string(nodeId);
+        for (const auto& inputField : node.getInputs()) {
+            std::vector<double> source;
+            if (inputField.first == "in") {
+                for (const auto& value : input.getData()) {
+                    source.push_back(std::get<double>(value));
+                }
+            } else {
+                source = results[std::stoul(inputField.first.substr(1))];
+            }
+            for (double value : source) {
+                inputs[inputField.first] = value;
+                outputs[output] = DataContainer();
+                node.execute(inputs, outputs);
+                results[nodeId].push_back(std::get<double>(outputs[output]));
+            }
+            inputs[inputField.first] = DataContainer();
+        }
+    }
+    return results;
+}
+
+// Every node declares a quarter of the grain, so coarsening clusters up to four connected nodes.
+static void setCoarsening(Executor& executor, RandomDag& dag, double grainSeconds) {
+    for (size_t nodeId = 0; nodeId < dag.graph.size(); ++nodeId) {
+        dag.graph.getNode(nodeId).setCostEstimate(grainSeconds / 4);
+    }
+    executor.setCoarsening(grainSeconds);
+}
+
+static bool checkRun(std::mt19937& rng, size_t numNodes, size_t numBatches, size_t numThreads, bool bufferReuse,
+                     ExecutionMode mode, double grainSeconds = 0.0) {
+    RandomDag dag = buildRandomDag(rng, numNodes, bufferReuse);
+
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputBatches(numBatches);
+    std::uniform_int_distribution<size_t> batchSize(0, 32);
+    std::uniform_real_distribution<double> value(-100.0, 100.0);
+    for (auto& batch : inputBatches) {
+        MiniBatch input;
+        for (size_t i = batchSize(rng); i > 0; --i) {
+            input.addData(value(rng));
+        }
+        batch["in"] = input;
+    }
+
+    Executor executor(dag.graph, inputBatches);
+    executor.setNumThreads(numThreads);
+    executor.setExecutionMode(mode);
+    setCoarsening(executor, dag, grainSeconds);
+    executor.run();
+
+    // without buffer reuse every intermediate is kept, with it only the results nobody consumes
+    std::vector<bool> consumed(numNodes, false);
+    for (const auto& nodePredecessors : dag.predecessors) {
+        for (size_t predecessor : nodePredecessors) {
+            consumed[predecessor] = true;
+        }
+    }
+
+    for (size_t batchId = 0; batchId < numBatches; ++batchId) {
+        std::vector<std::vector<double>> expected = referenceRun(dag, inputBatches[batchId]["in"]);
+        for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+            if (bufferReuse && consumed[nodeId]) {
+                continue;
+            }
+            const MiniBatch& output = dag.graph.getMiniBatch(nodeId, batchId, "f" + std::to_string(nodeId));
+            bool match = output.size() == expected[nodeId].size();
+            for (size_t i = 0; match && i < output.size(); ++i) {
+                match = std::get<double>(output.getData(i)) == expected[nodeId][i];
+            }
+            if (!match) {
+                std::cout << "Mismatch at node " << nodeId << ", batch " << batchId << "\n";
+                return false;
+            }
+        }
+    }
+
+    for (const auto& nodeStats : executor.getStats().nodes) {
+        if (nodeStats.invocations != numBatches) {
+            std::cout << "Node executed " << nodeStats.invocations << " times, expected " << numBatches << "\n";
+            return false;
+        }
+    }
+    if (grainSeconds > 0.0 && executor.getStats().scheduledTasks >= numNodes * numBatches) {
+        std::cout << "Coarsening scheduled " << executor.getStats().scheduledTasks << " tasks\n";
+        return false;
+    }
+    return true;
+}
+
+// Lazy evaluation of one node: exactly its ancestors run, then run() completes the remaining tasks.
+static bool checkEvaluate(std::mt19937& rng, size_t numNodes, size_t numBatches, size_t numThreads,
+                          double grainSeconds = 0.0) {
+    RandomDag dag = buildRandomDag(rng, numNodes, false);
+    std::vector<std::unordered_map<std::string, MiniBatch>> inputBatches(numBatches);
+    for (size_t batchId = 0; batchId < numBatches; ++batchId) {
+        inputBatches[batchId]["in"] = MiniBatch({1.0 + batchId, 2.0, -3.0});
+    }
+
+    Executor executor(dag.graph, inputBatches);
+    executor.setNumThreads(numThreads);
+    executor.setExecutionMode(ExecutionMode::Parallel);
+    setCoarsening(executor, dag, grainSeconds);
+    size_t target = std::uniform_int_distribution<size_t>(0, numNodes - 1)(rng);
+    size_t batchId = numBatches - 1;
+    const MiniBatch& output = executor.evaluate(target, "f" + std::to_string(target), batchId);
+
+    std::vector<bool> ancestor(numNodes, false);
+    ancestor[target] = true;
+    for (size_t nodeId = numNodes; nodeId-- > 0;) {
+        for (size_t predecessor : dag.predecessors[nodeId]) {
+            ancestor[predecessor] = ancestor[predecessor] || ancestor[nodeId];
+        }
+    }
+    for (size_t nodeId = 0; nodeId < numNodes; ++nodeId) {
+        if (executor.getStats().nodes[nodeId].invocations != (ancestor[nodeId] ? 1u : 0u)) {
+            std::cout << "Evaluate ran node " << nodeId << " " << executor.getStats().nodes[nodeId].invocations
+                      << " times\n";
+            return false;
+        }
+    }
+
+    std::vector<std::vector<double>> expected = referenceRun(dag, inputBatches[batchId]["in"]);
+    bool match = output.size() == expected[target].size();
+    for (size_t i = 0; match && i < output.size(); ++i) {
+        match = std::get<double>(output.getData(i)) == expected[target][i];
+    }
+
+    // the memoized tasks are not run again
+    executor.run();
+    for (const auto& nodeStats : executor.getStats().nodes) {
+        match = match && nodeStats.invocations == numBatches;
+    }
+    if (!match) {
+        std::cout << "Evaluate mismatch at node " << target << "\n";
+    }
+    return match;
+}
+
+int main() {
+    std::mt19937 rng(20240415);
+    size_t failures = 0;
+    size_t runs = 0;
+    for (size_t numThreads : {1, 4, 16, 64}) {
+        for (bool bufferReuse : {false, true}) {
+            for (size_t round = 0; round < 5; ++round) {
+                runs++;
+                if (!checkRun(rng, 30, 8, numThreads, bufferReuse, ExecutionMode::Parallel)) {
+                    failures++;
+                }
+            }
+        }
+    }
+    for (bool bufferReuse : {false, true}) {
+        runs++;
+        if (!checkRun(rng, 30, 8, 1, bufferReuse, ExecutionMode::Inline)) {
+            failures++;
+        }
+    }
+    for (size_t numThreads : {1, 4, 16}) {
+        runs++;
+        if (!checkEvaluate(rng, 30, 4, numThreads)) {
+            failures++;
+        }
+    }
+    // coarsened runs; after evaluate(), run() queues the members of clusters whose head already ran
+    for (size_t numThreads : {4, 16}) {
+        for (bool bufferReuse : {false, true}) {
+            runs++;
+            if (!checkRun(rng, 30, 8, numThreads, bufferReuse, ExecutionMode::Parallel, 1.0)) {
+                failures++;
+            }
+        }
+        runs++;
+        if (!checkEvaluate(rng, 30, 4, numThreads, 1.0)) {
+            failures++;
+        }
+    }
+    std::cout << "Stress runs: " << runs << ", failures: " << failures << "\n";
+    return failures == 0 ? 0 : 1;
+}